@@ -0,0 +1,1927 @@
+#include "bl_line.h"
+#include "bl_simd.h"
+#include "bl_publish.h"
+#include "bl_set.h"
+#include "bl_mesh.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <limits>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <new>
+#include <atomic>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//--------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------
+//every heap allocation of the process, for the alloc bench
+static size_t g_heapAllocs = 0;
+
+void* operator new(size_t bytes)
+{
+	g_heapAllocs++;
+	void* p = malloc(bytes ? bytes : 1);
+	if (p == nullptr) throw std::bad_alloc();
+	return p;
+}
+
+//gcc pairs the inlined malloc of operator new with the free here and warns of a mismatch
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+//--------------------------------------------------------------------------------------
+static double _now(void)
+{
+	using namespace std::chrono;
+	return duration_cast<duration<double>>(steady_clock::now().time_since_epoch()).count();
+}
+
+//--------------------------------------------------------------------------------------
+static Bline::Real _random(Bline::Real min, Bline::Real max)
+{
+	return min + (max - min)*(Bline::Real)rand() / (Bline::Real)RAND_MAX;
+}
+
+//--------------------------------------------------------------------------------------
+static void _randomKeys(std::vector<Bline::Real>& keys, size_t keyCounts, unsigned int seed)
+{
+	//wandering path, the heading turns well below 90 degree per key so there are no cusps
+	srand(seed);
+	keys.resize(keyCounts * 3);
+
+	Bline::Real x = 0, y = 0, z = 0;
+	Bline::Real yaw = 0, pitch = 0;
+	for (size_t i = 0; i < keyCounts; i++) {
+		keys[i * 3 + 0] = x;
+		keys[i * 3 + 1] = y;
+		keys[i * 3 + 2] = z;
+
+		yaw += _random((Bline::Real)-0.5, (Bline::Real)0.5);
+		pitch = _random((Bline::Real)-0.5, (Bline::Real)0.5);
+
+		Bline::Real step = _random((Bline::Real)20.0, (Bline::Real)70.0);
+		x += step*cos(yaw)*cos(pitch);
+		y += step*sin(pitch);
+		z += step*sin(yaw)*cos(pitch);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+static void _degenerateKeys(std::vector<Bline::Real>& keys, size_t keyCounts, Bline::Real noise, unsigned int seed)
+{
+	//nearly straight runs with uneven spacing, and nearly collinear runs which turn back
+	//on themselves. noise is the distance off the x axis, 0 means exactly collinear
+	srand(seed);
+	keys.resize(keyCounts * 3);
+
+	Bline::Real x = 0;
+	for (size_t i = 0; i < keyCounts; i++) {
+		bool zigzag = (i / 16) % 2 == 1;
+
+		x += zigzag ? ((i % 2) ? -_random(5, 10) : _random(10, 20)) : _random(1, 50);
+		keys[i * 3 + 0] = x;
+		keys[i * 3 + 1] = _random(-noise, noise);
+		keys[i * 3 + 2] = _random(-noise, noise);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+static void _straightKeys(std::vector<Bline::Real>& keys, size_t keyCounts, Bline::Real noise, unsigned int seed)
+{
+	//long straight runs with uneven spacing, the heading changes every 32 keys
+	srand(seed);
+	keys.resize(keyCounts * 3);
+
+	Bline::Real x = 0, y = 0, z = 0;
+	Bline::Real yaw = 0;
+	for (size_t i = 0; i < keyCounts; i++) {
+		keys[i * 3 + 0] = x + _random(-noise, noise);
+		keys[i * 3 + 1] = y + _random(-noise, noise);
+		keys[i * 3 + 2] = z + _random(-noise, noise);
+
+		if (i % 32 == 31) yaw += _random((Bline::Real)-1.0, (Bline::Real)1.0);
+
+		Bline::Real step = _random((Bline::Real)5.0, (Bline::Real)50.0);
+		x += step*cos(yaw);
+		y += step*sin(yaw);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// getPoints against the scalar loop BlineHelper used to build the line vertex buffer
+//--------------------------------------------------------------------------------------
+static void _benchBatch(void)
+{
+	const size_t keyCounts[] = { 10, 100, 1000 };
+	const size_t sampleCounts = 1000000;
+
+	printf("== batch sampling (%u samples)\n", (unsigned int)sampleCounts);
+	printf("%10s %16s %16s %8s\n", "keys", "scalar(smp/s)", "batch(smp/s)", "speedup");
+
+	std::vector<Bline::Real> t(sampleCounts), buf(sampleCounts * 6);
+	for (size_t i = 0; i < sampleCounts; i++) {
+		t[i] = (Bline::Real)i / (Bline::Real)(sampleCounts - 1);
+	}
+	Bline::PointArray points = { &buf[0], &buf[sampleCounts], &buf[sampleCounts * 2] };
+	Bline::PointArray tangents = { &buf[sampleCounts * 3], &buf[sampleCounts * 4], &buf[sampleCounts * 5] };
+
+	for (size_t k = 0; k < sizeof(keyCounts) / sizeof(keyCounts[0]); k++) {
+		std::vector<Bline::Real> keys;
+		_randomKeys(keys, keyCounts[k], 1);
+
+		Bline bline;
+		bline.build(&keys[0], (unsigned int)keyCounts[k]);
+
+		std::vector<Bline::Point> scalarPoints(sampleCounts);
+		double begin = _now();
+		for (size_t i = 0; i < sampleCounts; i++) {
+			Bline::Point ta;
+			bline.getPoint(t[i], scalarPoints[i], ta);
+		}
+		double scalar = _now() - begin;
+
+		begin = _now();
+		bline.getPoints(&t[0], sampleCounts, points, tangents);
+		double batch = _now() - begin;
+
+		bool match = true;
+		for (size_t i = 0; i < sampleCounts; i++) {
+			if (points.x[i] != scalarPoints[i].x || points.y[i] != scalarPoints[i].y || points.z[i] != scalarPoints[i].z) match = false;
+		}
+
+		printf("%10u %16.0f %16.0f %7.2fx%s\n", (unsigned int)keyCounts[k],
+			sampleCounts / scalar, sampleCounts / batch, scalar / batch, match ? "" : " (MISMATCH)");
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// getPoint with random t, the part search dominates as the key counts grows
+//--------------------------------------------------------------------------------------
+static void _benchSearch(void)
+{
+	const size_t sampleCounts = 1000000;
+
+	printf("== random getPoint (%u samples)\n", (unsigned int)sampleCounts);
+	printf("%10s %12s %16s %12s\n", "keys", "build(s)", "getPoint(smp/s)", "ns/sample");
+
+	std::vector<Bline::Real> t(sampleCounts);
+	srand(2);
+	for (size_t i = 0; i < sampleCounts; i++) {
+		t[i] = (Bline::Real)rand() / (Bline::Real)RAND_MAX;
+	}
+
+	for (size_t keyCounts = 10; keyCounts <= 10000000; keyCounts *= 10) {
+		std::vector<Bline::Real> keys;
+		_randomKeys(keys, keyCounts, 1);
+
+		Bline bline;
+		double begin = _now();
+		bline.build(&keys[0], (unsigned int)keyCounts);
+		double build = _now() - begin;
+
+		begin = _now();
+		Bline::Real checksum = 0;
+		for (size_t i = 0; i < sampleCounts; i++) {
+			Bline::Point pt, ta;
+			bline.getPoint(t[i], pt, ta);
+			checksum += pt.x;
+		}
+		double sample = _now() - begin;
+
+		printf("%10u %12.3f %16.0f %12.1f\n", (unsigned int)keyCounts, build,
+			sampleCounts / sample, sample * 1e9 / sampleCounts);
+		if (checksum != checksum) printf("  (nan in samples)\n");
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Newton inversion against the fitted t(s) tables
+//--------------------------------------------------------------------------------------
+static void _benchFastInvert(void)
+{
+	const size_t keyCounts = 10000;
+	const size_t sampleCounts = 1000000;
+
+	printf("== fast inverse (%u keys, %u samples)\n", (unsigned int)keyCounts, (unsigned int)sampleCounts);
+	printf("%-22s %10s %16s %12s %14s\n", "mode", "build(s)", "getPoint(smp/s)", "table(KB)", "max pos err");
+
+	std::vector<Bline::Real> keys, t(sampleCounts);
+	_randomKeys(keys, keyCounts, 1);
+	srand(2);
+	for (size_t i = 0; i < sampleCounts; i++) {
+		t[i] = (Bline::Real)rand() / (Bline::Real)RAND_MAX;
+	}
+
+	Bline exact;
+	exact.build(&keys[0], (unsigned int)keyCounts);
+	std::vector<Bline::Point> exactPoints(sampleCounts);
+	for (size_t i = 0; i < sampleCounts; i++) {
+		Bline::Point ta;
+		exact.getPoint(t[i], exactPoints[i], ta);
+	}
+
+	struct Mode {
+		const char* name;
+		bool enable;
+		Bline::Real error;
+		bool polish;
+	};
+	const Mode modes[] = {
+		{ "newton", false, 0, false },
+		{ "table 1e-3", true, (Bline::Real)1e-3, false },
+		{ "table 1e-4", true, (Bline::Real)1e-4, false },
+		{ "table 1e-6", true, (Bline::Real)1e-6, false },
+		{ "table 1e-3 + polish", true, (Bline::Real)1e-3, true },
+	};
+
+	for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		Bline bline;
+		bline.setFastInvert(modes[m].enable, modes[m].error, modes[m].polish);
+
+		double begin = _now();
+		bline.build(&keys[0], (unsigned int)keyCounts);
+		double build = _now() - begin;
+
+		Bline::Real maxError = 0;
+		begin = _now();
+		for (size_t i = 0; i < sampleCounts; i++) {
+			Bline::Point pt, ta;
+			bline.getPoint(t[i], pt, ta);
+
+			Bline::Real dx = pt.x - exactPoints[i].x, dy = pt.y - exactPoints[i].y, dz = pt.z - exactPoints[i].z;
+			Bline::Real e = dx*dx + dy*dy + dz*dz;
+			if (e > maxError) maxError = e;
+		}
+		double sample = _now() - begin;
+
+		size_t bytes, newtonParts;
+		Bline::Real tableError;
+		bline.getFastInvertInfo(bytes, tableError, newtonParts);
+
+		printf("%-22s %10.3f %16.0f %12.1f %14.3g\n", modes[m].name, build, sampleCounts / sample,
+			bytes / 1024.0, sqrt(maxError));
+		if (modes[m].enable) {
+			printf("%-22s fitted parameter error %.3g, %u parts on newton\n", "", tableError, (unsigned int)newtonParts);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// getPoint latency distribution on straight and near collinear parts
+//--------------------------------------------------------------------------------------
+static void _benchLatency(void)
+{
+	const size_t keyCounts = 1000;
+	const size_t sampleCounts = 200000;
+
+	printf("== getPoint latency, near collinear keys (%u keys, %u samples)\n", (unsigned int)keyCounts, (unsigned int)sampleCounts);
+	printf("%8s %10s %10s %10s %10s %8s %10s %12s\n", "maxIter", "p50(ns)", "p99(ns)", "p99.9(ns)", "max(ns)",
+		"iter max", "fallbacks", "unconverged");
+
+	std::vector<Bline::Real> keys, t(sampleCounts);
+	_degenerateKeys(keys, keyCounts, (Bline::Real)0.001, 3);
+	srand(4);
+	for (size_t i = 0; i < sampleCounts; i++) {
+		t[i] = (Bline::Real)rand() / (Bline::Real)RAND_MAX;
+	}
+
+	const unsigned int maxIterations[] = { 4, 8, 16, 32, 64 };
+	std::vector<double> latency(sampleCounts);
+
+	for (size_t m = 0; m < sizeof(maxIterations) / sizeof(maxIterations[0]); m++) {
+		Bline bline;
+		bline.setMaxIterations(maxIterations[m]);
+		bline.build(&keys[0], (unsigned int)keyCounts);
+
+		unsigned int iterMax = 0, fallbacks = 0, unconverged = 0;
+		for (size_t i = 0; i < sampleCounts; i++) {
+			Bline::Point pt, ta;
+			Bline::InvertStats stats;
+
+			double begin = _now();
+			bline.getPoint(t[i], pt, ta, &stats);
+			latency[i] = (_now() - begin)*1e9;
+
+			if (stats.iterations > iterMax) iterMax = stats.iterations;
+			fallbacks += stats.fallbacks;
+			if (!stats.converged) unconverged++;
+		}
+
+		std::sort(latency.begin(), latency.end());
+		printf("%8u %10.0f %10.0f %10.0f %10.0f %8u %10u %12u\n", maxIterations[m],
+			latency[sampleCounts / 2], latency[sampleCounts * 99 / 100], latency[sampleCounts * 999 / 1000],
+			latency[sampleCounts - 1], iterMax, fallbacks, unconverged);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// straight runs with occasional bends, exact against slightly noisy keys
+//--------------------------------------------------------------------------------------
+static void _benchStraight(void)
+{
+	const size_t keyCounts = 10000;
+	const size_t sampleCounts = 1000000;
+
+	printf("== straight parts (%u keys, %u samples)\n", (unsigned int)keyCounts, (unsigned int)sampleCounts);
+	printf("%10s %10s %10s %10s %16s\n", "noise", "straight", "near", "general", "getPoint(smp/s)");
+
+	std::vector<Bline::Real> t(sampleCounts);
+	srand(2);
+	for (size_t i = 0; i < sampleCounts; i++) {
+		t[i] = (Bline::Real)rand() / (Bline::Real)RAND_MAX;
+	}
+
+	const Bline::Real noise[] = { (Bline::Real)0.0, (Bline::Real)1e-9, (Bline::Real)1e-4, (Bline::Real)0.1 };
+	for (size_t n = 0; n < sizeof(noise) / sizeof(noise[0]); n++) {
+		std::vector<Bline::Real> keys;
+		_straightKeys(keys, keyCounts, noise[n], 5);
+
+		Bline bline;
+		bline.build(&keys[0], (unsigned int)keyCounts);
+
+		size_t straight, nearStraight, general;
+		bline.getPartTypeCounts(straight, nearStraight, general);
+
+		double begin = _now();
+		Bline::Real checksum = 0;
+		for (size_t i = 0; i < sampleCounts; i++) {
+			Bline::Point pt, ta;
+			bline.getPoint(t[i], pt, ta);
+			checksum += pt.x;
+		}
+		double sample = _now() - begin;
+
+		printf("%10.0e %10u %10u %10u %16.0f%s\n", noise[n], (unsigned int)straight, (unsigned int)nearStraight,
+			(unsigned int)general, sampleCounts / sample, checksum == checksum ? "" : " (nan)");
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// planar, spatial closed form and quadrature length
+//--------------------------------------------------------------------------------------
+static void _benchLength(void)
+{
+	const size_t keyCounts = 100000;
+	const size_t sampleCounts = 1000000;
+
+	printf("== length mode (%u keys, %u samples)\n", (unsigned int)keyCounts, (unsigned int)sampleCounts);
+	printf("%-12s %10s %16s %14s\n", "mode", "build(s)", "getPoint(smp/s)", "check error");
+
+	std::vector<Bline::Real> keys, t(sampleCounts);
+	_randomKeys(keys, keyCounts, 1);
+	srand(2);
+	for (size_t i = 0; i < sampleCounts; i++) {
+		t[i] = (Bline::Real)rand() / (Bline::Real)RAND_MAX;
+	}
+
+	struct Mode {
+		const char* name;
+		Bline::LengthMode mode;
+	};
+	const Mode modes[] = {
+		{ "planar", Bline::LM_PLANAR },
+		{ "spatial", Bline::LM_SPATIAL },
+		{ "quadrature", Bline::LM_QUADRATURE },
+	};
+
+	for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		Bline bline;
+		bline.setLengthMode(modes[m].mode);
+
+		double begin = _now();
+		bline.build(&keys[0], (unsigned int)keyCounts);
+		double build = _now() - begin;
+
+		begin = _now();
+		for (size_t i = 0; i < sampleCounts; i++) {
+			Bline::Point pt, ta;
+			bline.getPoint(t[i], pt, ta);
+		}
+		double sample = _now() - begin;
+
+		printf("%-12s %10.3f %16.0f %14.3g\n", modes[m].name, build, sampleCounts / sample, bline.checkLength());
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// simd kernels, alone and inside getPoints tessellation
+//--------------------------------------------------------------------------------------
+static void _benchSimd(void)
+{
+	const size_t keyCounts = 10000;
+	const size_t sampleCounts = 1000000;
+	const char* levelName[] = { "scalar", "sse2", "avx2" };
+
+	BlineSimd::Level supported = BlineSimd::getSupportedLevel();
+	printf("== simd kernels (%u samples, cpu supports %s)\n", (unsigned int)sampleCounts, levelName[supported]);
+	printf("%-8s %16s %20s %20s %10s\n", "level", "kernel(smp/s)", "tess newton(smp/s)", "tess table(smp/s)", "same bits");
+
+	std::vector<Bline::Real> keys, t(sampleCounts), controls(keyCounts * 9), buf(sampleCounts * 6), ref(sampleCounts * 6);
+	std::vector<size_t> part(sampleCounts);
+	_randomKeys(keys, keyCounts, 1);
+
+	srand(2);
+	for (size_t i = 0; i < keyCounts * 9; i++) controls[i] = _random(-100, 100);
+	for (size_t i = 0; i < sampleCounts; i++) {
+		part[i] = (size_t)rand() % keyCounts;
+		t[i] = (Bline::Real)rand() / (Bline::Real)RAND_MAX;
+	}
+
+	Bline newton, table;
+	newton.build(&keys[0], (unsigned int)keyCounts);
+	table.setFastInvert(true, (Bline::Real)1e-4);
+	table.build(&keys[0], (unsigned int)keyCounts);
+
+	std::vector<Bline::Real> sorted(sampleCounts);
+	for (size_t i = 0; i < sampleCounts; i++) sorted[i] = (Bline::Real)i / (Bline::Real)(sampleCounts - 1);
+
+	Bline::Real* b = &buf[0];
+	Bline::PointArray points = { b, b + sampleCounts, b + sampleCounts * 2 };
+	Bline::PointArray tangents = { b + sampleCounts * 3, b + sampleCounts * 4, b + sampleCounts * 5 };
+
+	for (int level = BlineSimd::SL_SCALAR; level <= supported; level++) {
+		BlineSimd::setLevel((BlineSimd::Level)level);
+
+		double begin = _now();
+		BlineSimd::evaluate(&t[0], &part[0], sampleCounts, &controls[0], 9, points.x, points.y, points.z, tangents.x, tangents.y, tangents.z);
+		double kernel = _now() - begin;
+
+		bool same = true;
+		if (level == BlineSimd::SL_SCALAR) ref = buf;
+		else same = (ref == buf);
+
+		begin = _now();
+		newton.getPoints(&sorted[0], sampleCounts, points, tangents);
+		double tessNewton = _now() - begin;
+
+		begin = _now();
+		table.getPoints(&sorted[0], sampleCounts, points, tangents);
+		double tessTable = _now() - begin;
+
+		printf("%-8s %16.0f %20.0f %20.0f %10s\n", levelName[level], sampleCounts / kernel,
+			sampleCounts / tessNewton, sampleCounts / tessTable, same ? "yes" : "NO");
+	}
+	BlineSimd::setLevel(supported);
+}
+
+//--------------------------------------------------------------------------------------
+// float against double curves, tessellation throughput and deviation
+//--------------------------------------------------------------------------------------
+static void _benchFloat(void)
+{
+	const size_t keyCounts = 10000;
+	const size_t sampleCounts = 1000000;
+
+	printf("== float vs double (%u keys, %u samples)\n", (unsigned int)keyCounts, (unsigned int)sampleCounts);
+	printf("%-8s %10s %16s %14s\n", "type", "build(s)", "tess(smp/s)", "max dev");
+
+	std::vector<Bline::Real> keys, sorted(sampleCounts), buf(sampleCounts * 6);
+	_randomKeys(keys, keyCounts, 1);
+	for (size_t i = 0; i < sampleCounts; i++) sorted[i] = (Bline::Real)i / (Bline::Real)(sampleCounts - 1);
+
+	std::vector<BlineF::Real> keysF(keys.begin(), keys.end()), sortedF(sorted.begin(), sorted.end()), bufF(sampleCounts * 6);
+
+	Bline bline;
+	double begin = _now();
+	bline.build(&keys[0], (unsigned int)keyCounts);
+	double build = _now() - begin;
+
+	Bline::Real* b = &buf[0];
+	Bline::PointArray points = { b, b + sampleCounts, b + sampleCounts * 2 };
+	Bline::PointArray tangents = { b + sampleCounts * 3, b + sampleCounts * 4, b + sampleCounts * 5 };
+
+	begin = _now();
+	bline.getPoints(&sorted[0], sampleCounts, points, tangents);
+	double sample = _now() - begin;
+	printf("%-8s %10.3f %16.0f %14s\n", "double", build, sampleCounts / sample, "-");
+
+	BlineF blineF;
+	begin = _now();
+	blineF.build(&keysF[0], (unsigned int)keyCounts);
+	build = _now() - begin;
+
+	BlineF::Real* f = &bufF[0];
+	BlineF::PointArray pointsF = { f, f + sampleCounts, f + sampleCounts * 2 };
+	BlineF::PointArray tangentsF = { f + sampleCounts * 3, f + sampleCounts * 4, f + sampleCounts * 5 };
+
+	begin = _now();
+	blineF.getPoints(&sortedF[0], sampleCounts, pointsF, tangentsF);
+	sample = _now() - begin;
+
+	//deviation in world units, relative to the curve extent
+	Bline::Real deviation = 0;
+	for (size_t i = 0; i < sampleCounts * 3; i++) {
+		deviation = std::max(deviation, (Bline::Real)fabs(buf[i] - (Bline::Real)bufF[i]));
+	}
+	printf("%-8s %10.3f %16.0f %14.3g\n", "float", build, sampleCounts / sample, deviation);
+}
+
+//--------------------------------------------------------------------------------------
+// dragging single keys, setKey against a full rebuild
+//--------------------------------------------------------------------------------------
+static void _benchEdit(void)
+{
+	const size_t editCounts = 10000;
+	const size_t sampleCounts = 100000;
+
+	printf("== key edits (%u edits)\n", (unsigned int)editCounts);
+	printf("%10s %-8s %14s %14s %14s\n", "keys", "invert", "build(us)", "setKey(us)", "max dev");
+
+	for (size_t keyCounts = 1000; keyCounts <= 1000000; keyCounts *= 10) {
+		for (int table = 0; table < 2; table++) {
+			std::vector<Bline::Real> keys;
+			_randomKeys(keys, keyCounts, 1);
+
+			Bline bline, fresh;
+			bline.setFastInvert(table != 0);
+			fresh.setFastInvert(table != 0);
+			bline.build(&keys[0], (unsigned int)keyCounts);
+
+			//drag keys a little, both ends included
+			srand(3);
+			double begin = _now();
+			for (size_t i = 0; i < editCounts; i++) {
+				size_t index = (i < 4) ? ((i < 2) ? i : keyCounts - 1 - (i - 2)) : (size_t)rand() % keyCounts;
+				Bline::Point point = bline.getKeys()[index];
+				point.x += _random(-5, 5);
+				point.y += _random(-5, 5);
+				point.z += _random(-5, 5);
+				bline.setKey(index, point);
+			}
+			double edit = (_now() - begin) / editCounts;
+
+			for (size_t i = 0; i < keyCounts; i++) {
+				keys[i * 3 + 0] = bline.getKeys()[i].x;
+				keys[i * 3 + 1] = bline.getKeys()[i].y;
+				keys[i * 3 + 2] = bline.getKeys()[i].z;
+			}
+			begin = _now();
+			fresh.build(&keys[0], (unsigned int)keyCounts);
+			double build = _now() - begin;
+
+			//edited and rebuilt lines should only differ by rounding in the lengths
+			Bline::Real deviation = 0;
+			for (size_t i = 0; i <= sampleCounts; i++) {
+				Bline::Real t = (Bline::Real)i / (Bline::Real)sampleCounts;
+				Bline::Point p0, p1, t0, t1;
+				bline.getPoint(t, p0, t0);
+				fresh.getPoint(t, p1, t1);
+				deviation = std::max(deviation, (Bline::Real)(fabs(p0.x - p1.x) + fabs(p0.y - p1.y) + fabs(p0.z - p1.z)));
+			}
+
+			printf("%10u %-8s %14.1f %14.2f %14.3g\n", (unsigned int)keyCounts, table ? "table" : "newton",
+				build*1e6, edit*1e6, deviation);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// live stream, appendKey key by key against one build of the whole array
+//--------------------------------------------------------------------------------------
+static void _benchAppend(void)
+{
+	const size_t sampleCounts = 100000;
+
+	printf("== append stream\n");
+	printf("%10s %-8s %14s %16s %14s\n", "keys", "invert", "build(ms)", "append(ns/key)", "max dev");
+
+	for (size_t keyCounts = 1000; keyCounts <= 1000000; keyCounts *= 10) {
+		for (int table = 0; table < 2; table++) {
+			std::vector<Bline::Real> keys;
+			_randomKeys(keys, keyCounts, 1);
+
+			Bline stream, whole;
+			stream.setFastInvert(table != 0);
+			whole.setFastInvert(table != 0);
+
+			double begin = _now();
+			for (size_t i = 0; i < keyCounts; i++) {
+				Bline::Point point = { keys[i * 3 + 0], keys[i * 3 + 1], keys[i * 3 + 2] };
+				stream.appendKey(point);
+			}
+			double append = (_now() - begin) / keyCounts;
+
+			begin = _now();
+			whole.build(&keys[0], (unsigned int)keyCounts);
+			double build = _now() - begin;
+
+			Bline::Real deviation = 0;
+			for (size_t i = 0; i <= sampleCounts; i++) {
+				Bline::Real t = (Bline::Real)i / (Bline::Real)sampleCounts;
+				Bline::Point p0, p1, t0, t1;
+				stream.getPoint(t, p0, t0);
+				whole.getPoint(t, p1, t1);
+				deviation = std::max(deviation, (Bline::Real)(fabs(p0.x - p1.x) + fabs(p0.y - p1.y) + fabs(p0.z - p1.z)));
+			}
+
+			printf("%10u %-8s %14.2f %16.1f %14.3g\n", (unsigned int)keyCounts, table ? "table" : "newton",
+				build*1e3, append*1e9, deviation);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// build scaling over thread counts
+//--------------------------------------------------------------------------------------
+static void _benchBuild(void)
+{
+	const size_t sampleCounts = 100000;
+	unsigned int hardware = std::thread::hardware_concurrency();
+	unsigned int maxThreads = (hardware > 4) ? hardware : 4;
+
+	printf("== parallel build (%u hardware threads)\n", hardware);
+	printf("%10s %-8s %8s %12s %10s %10s\n", "keys", "invert", "threads", "build(s)", "speedup", "same bits");
+
+	for (size_t keyCounts = 1000000; keyCounts <= 10000000; keyCounts *= 10) {
+		std::vector<Bline::Real> keys;
+		_randomKeys(keys, keyCounts, 1);
+
+		for (int table = 0; table < 2; table++) {
+			//the table fit is slow, one size is enough to show it
+			if (table && keyCounts > 1000000) continue;
+
+			std::vector<Bline::Real> ref(sampleCounts * 3), buf(sampleCounts * 3);
+			double single = 0;
+
+			for (unsigned int threads = 1; threads <= maxThreads; threads *= 2) {
+				Bline bline;
+				bline.setFastInvert(table != 0);
+				bline.setThreadCounts(threads);
+
+				double begin = _now();
+				bline.build(&keys[0], (unsigned int)keyCounts);
+				double build = _now() - begin;
+				if (threads == 1) single = build;
+
+				for (size_t i = 0; i < sampleCounts; i++) {
+					Bline::Point pt, ta;
+					bline.getPoint((Bline::Real)i / (Bline::Real)(sampleCounts - 1), pt, ta);
+					buf[i * 3 + 0] = pt.x;
+					buf[i * 3 + 1] = pt.y;
+					buf[i * 3 + 2] = pt.z;
+				}
+				if (threads == 1) ref = buf;
+
+				printf("%10u %-8s %8u %12.3f %9.2fx %10s\n", (unsigned int)keyCounts, table ? "table" : "newton",
+					threads, build, single / build, (ref == buf) ? "yes" : "NO");
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// build straight from an interleaved float vertex buffer against a packed copy first
+//--------------------------------------------------------------------------------------
+struct BenchVertex
+{
+	float pos[3];
+	float normal[3];
+	float color[4];
+};
+
+static void _benchStride(void)
+{
+	const size_t sampleCounts = 100000;
+
+	printf("== strided build (%u byte vertex)\n", (unsigned int)sizeof(BenchVertex));
+	printf("%10s %16s %16s %16s %10s\n", "keys", "copy+build(s)", "strided(s)", "strided float(s)", "same bits");
+
+	for (size_t keyCounts = 10000; keyCounts <= 1000000; keyCounts *= 10) {
+		std::vector<Bline::Real> keys;
+		_randomKeys(keys, keyCounts, 1);
+
+		std::vector<BenchVertex> vertices(keyCounts);
+		for (size_t i = 0; i < keyCounts; i++) {
+			BenchVertex& v = vertices[i];
+			for (int k = 0; k < 3; k++) {
+				v.pos[k] = (float)keys[i * 3 + k];
+				v.normal[k] = 0.0f;
+			}
+			for (int k = 0; k < 4; k++) v.color[k] = 1.0f;
+		}
+
+		//what a caller had to do before, convert to packed double then build
+		Bline packed;
+		double begin = _now();
+		std::vector<Bline::Real> converted(keyCounts * 3);
+		for (size_t i = 0; i < keyCounts; i++) {
+			for (int k = 0; k < 3; k++) converted[i * 3 + k] = (Bline::Real)vertices[i].pos[k];
+		}
+		packed.build(&converted[0], keyCounts);
+		double copyBuild = _now() - begin;
+
+		Bline strided;
+		begin = _now();
+		strided.build(&vertices[0].pos[0], sizeof(BenchVertex), Bline::CT_FLOAT, keyCounts);
+		double stridedBuild = _now() - begin;
+
+		BlineF stridedF;
+		begin = _now();
+		stridedF.build(&vertices[0].pos[0], sizeof(BenchVertex), BlineF::CT_FLOAT, keyCounts);
+		double stridedBuildF = _now() - begin;
+
+		bool same = true;
+		for (size_t i = 0; i < sampleCounts && same; i++) {
+			Bline::Real t = (Bline::Real)i / (Bline::Real)(sampleCounts - 1);
+			Bline::Point p0, p1, t0, t1;
+			packed.getPoint(t, p0, t0);
+			strided.getPoint(t, p1, t1);
+			same = (p0.x == p1.x && p0.y == p1.y && p0.z == p1.z);
+		}
+
+		printf("%10u %16.3f %16.3f %16.3f %10s\n", (unsigned int)keyCounts, copyBuild, stridedBuild, stridedBuildF, same ? "yes" : "NO");
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// allocations of repeated rebuilds, fresh lines, reused lines and per frame arenas
+//--------------------------------------------------------------------------------------
+class CountingAllocator : public BlineAllocator
+{
+public:
+	size_t counts;
+
+	CountingAllocator() : counts(0) {}
+	virtual void* allocate(size_t bytes, size_t alignment)
+	{
+		counts++;
+		return BlineAllocator::getDefault()->allocate(bytes, alignment);
+	}
+	virtual void deallocate(void* p, size_t bytes, size_t alignment)
+	{
+		BlineAllocator::getDefault()->deallocate(p, bytes, alignment);
+	}
+};
+
+//bump allocator over one block, freed all at once at the end of a frame
+class ArenaAllocator : public BlineAllocator
+{
+public:
+	size_t counts;
+
+	ArenaAllocator(size_t bytes) : counts(0), m_block((char*)malloc(bytes)), m_size(bytes), m_used(0) {}
+	~ArenaAllocator() { free(m_block); }
+
+	virtual void* allocate(size_t bytes, size_t alignment)
+	{
+		counts++;
+		size_t offset = (m_used + alignment - 1) / alignment * alignment;
+		if (offset + bytes > m_size) throw std::bad_alloc();
+		m_used = offset + bytes;
+		return m_block + offset;
+	}
+	virtual void deallocate(void*, size_t, size_t) {}
+	void reset(void) { m_used = 0; }
+
+private:
+	char*	m_block;
+	size_t	m_size;
+	size_t	m_used;
+};
+
+static void _benchAlloc(void)
+{
+	const size_t keyCounts = 10000;
+	const size_t frameCounts = 1000;
+
+	printf("== rebuild allocations (%u keys, %u frames)\n", (unsigned int)keyCounts, (unsigned int)frameCounts);
+	printf("%-20s %16s %16s %14s\n", "mode", "line allocs/frm", "heap allocs/frm", "us/frame");
+
+	std::vector<Bline::Real> keys, frame;
+	_randomKeys(keys, keyCounts, 1);
+	frame = keys;
+
+	const char* modes[] = { "fresh line", "reused line", "reused, varying", "arena per frame", "reused, table" };
+	for (int mode = 0; mode < 5; mode++) {
+		CountingAllocator counting;
+		ArenaAllocator arena(keyCounts * 1024);
+		Bline reused;
+		reused.setAllocator(&counting);
+		reused.setFastInvert(mode == 4);
+
+		size_t heapAllocs = 0;
+		double total = 0;
+		srand(3);
+		for (size_t f = 0; f < frameCounts; f++) {
+			for (size_t i = 0; i < keyCounts * 3; i++) frame[i] = keys[i] + _random(-1, 1);
+			size_t counts = (mode == 2) ? keyCounts / 2 + (size_t)rand() % (keyCounts / 2) : keyCounts;
+
+			size_t heapBegin = g_heapAllocs;
+			double begin = _now();
+			if (mode == 0) {
+				Bline bline;
+				bline.setAllocator(&counting);
+				bline.build(&frame[0], counts);
+			}
+			else if (mode == 3) {
+				Bline bline;
+				bline.setAllocator(&arena);
+				bline.build(&frame[0], counts);
+				arena.reset();
+			}
+			else {
+				reused.build(&frame[0], counts);
+			}
+			total += _now() - begin;
+			heapAllocs += g_heapAllocs - heapBegin;
+		}
+
+		size_t lineAllocs = (mode == 3) ? arena.counts : counting.counts;
+		printf("%-20s %16.2f %16.2f %14.1f\n", modes[mode], (double)lineAllocs / frameCounts,
+			(double)heapAllocs / frameCounts, total * 1e6 / frameCounts);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// lines by value, moves into containers and snapshots handed to worker threads
+//--------------------------------------------------------------------------------------
+static void _benchShare(void)
+{
+	const size_t keyCounts = 1000000;
+	const size_t sampleCounts = 1000000;
+	const size_t workerCounts = 4;
+
+	printf("== moves and snapshots (%u keys)\n", (unsigned int)keyCounts);
+
+	std::vector<Bline::Real> keys;
+	_randomKeys(keys, keyCounts, 1);
+
+	//a thousand small lines grown into a vector one by one, every growth moves them
+	std::vector<Bline> lines;
+	double begin = _now();
+	for (size_t i = 0; i < 1000; i++) {
+		Bline line;
+		line.build(&keys[i * 3], 100);
+		lines.push_back(std::move(line));
+	}
+	printf("vector of 1000 lines           %10.3f ms\n", (_now() - begin)*1e3);
+
+	Bline bline;
+	bline.setFastInvert(true);
+	bline.build(&keys[0], keyCounts);
+
+	begin = _now();
+	Bline::Snapshot snapshot = bline.share();
+	printf("share()                        %10.3f us (line left with %u keys)\n", (_now() - begin)*1e6, (unsigned int)bline.getKeyCounts());
+
+	std::vector<Bline::Real> t(sampleCounts);
+	for (size_t i = 0; i < sampleCounts; i++) t[i] = (Bline::Real)i / (Bline::Real)(sampleCounts - 1);
+
+	//every worker samples its own copy of the snapshot pointer, the main thread checks them
+	std::vector<std::vector<Bline::Real> > results(workerCounts + 1, std::vector<Bline::Real>(sampleCounts * 6));
+	auto sample = [&](Bline::Snapshot line, size_t index) {
+		Bline::Real* b = &results[index][0];
+		Bline::PointArray points = { b, b + sampleCounts, b + sampleCounts * 2 };
+		Bline::PointArray tangents = { b + sampleCounts * 3, b + sampleCounts * 4, b + sampleCounts * 5 };
+		line->getPoints(&t[0], sampleCounts, points, tangents);
+	};
+
+	begin = _now();
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < workerCounts; i++) {
+		workers.push_back(std::thread(sample, snapshot, i + 1));
+	}
+	for (size_t i = 0; i < workerCounts; i++) workers[i].join();
+	double shared = _now() - begin;
+
+	sample(snapshot, 0);
+	bool same = true;
+	for (size_t i = 1; i <= workerCounts; i++) same = same && (results[i] == results[0]);
+	printf("%u workers on one snapshot     %10.3f ms, same bits %s, use count %ld\n", (unsigned int)workerCounts,
+		shared*1e3, same ? "yes" : "NO", snapshot.use_count());
+}
+
+//--------------------------------------------------------------------------------------
+// one writer rebuilding and publishing while readers sample without locks
+//--------------------------------------------------------------------------------------
+static void _benchPublish(void)
+{
+	const size_t keyCounts = 100000;
+	const size_t versionCounts = 200;
+	const size_t readerCounts = 4;
+
+	printf("== publish (%u keys, %u versions, %u readers)\n", (unsigned int)keyCounts, (unsigned int)versionCounts, (unsigned int)readerCounts);
+
+	std::vector<Bline::Real> keys;
+	_randomKeys(keys, keyCounts, 1);
+
+	BlinePublisher publisher;
+	std::atomic<bool> done(false);
+	std::atomic<size_t> reads(0), torn(0);
+	size_t maxRetired = 0;
+
+	//version v is the key set moved by v along x, a reader sees a whole version when both
+	//ends of the line were moved by the same v
+	auto reader = [&](unsigned int seed) {
+		BlinePublisher::Reader r(publisher);
+		size_t counts = 0;
+		while (!done) {
+			const Bline* line = r.enter();
+			if (line) {
+				const Bline::Point* k = line->getKeys();
+				Bline::Real v = k[0].x - keys[0];
+				Bline::Point pt, ta;
+				seed = seed * 1103515245 + 12345;
+				line->getPoint((Bline::Real)(seed >> 8) / (Bline::Real)(1 << 24), pt, ta);
+				if (k[keyCounts - 1].x != keys[(keyCounts - 1) * 3] + v || pt.x != pt.x) torn++;
+				counts++;
+			}
+			r.leave();
+		}
+		reads += counts;
+	};
+
+	std::vector<std::thread> readers;
+	for (size_t i = 0; i < readerCounts; i++) readers.push_back(std::thread(reader, (unsigned int)i + 1));
+
+	double begin = _now();
+	std::vector<Bline::Real> moved(keys);
+	Bline bline;
+	for (size_t v = 0; v < versionCounts; v++) {
+		for (size_t i = 0; i < keyCounts; i++) moved[i * 3] = keys[i * 3] + (Bline::Real)v;
+		bline.build(&moved[0], keyCounts);
+		publisher.publish(std::move(bline));
+
+		size_t retired = publisher.getRetiredCounts();
+		if (retired > maxRetired) maxRetired = retired;
+	}
+	double elapsed = _now() - begin;
+
+	done = true;
+	for (size_t i = 0; i < readerCounts; i++) readers[i].join();
+	publisher.reclaim();
+
+	printf("versions/s %10.1f   reads/s %12.0f   torn reads %u   max retired %u   left retired %u\n",
+		versionCounts / elapsed, reads / elapsed, (unsigned int)torn, (unsigned int)maxRetired,
+		(unsigned int)publisher.getRetiredCounts());
+}
+
+//--------------------------------------------------------------------------------------
+// closest point queries, bvh against a brute force scan of dense samples
+//--------------------------------------------------------------------------------------
+static void _benchProject(void)
+{
+	const size_t keyCounts = 100002;
+	const size_t queryCounts = 200;
+	const size_t perPart = 16;
+
+	printf("== project (%u parts, %u queries)\n", (unsigned int)(keyCounts - 2), (unsigned int)queryCounts);
+
+	std::vector<Bline::Real> keys;
+	_randomKeys(keys, keyCounts, 1);
+
+	Bline bline;
+	double begin = _now();
+	bline.build(&keys[0], keyCounts);
+	printf("build with bvh                 %10.3f ms\n", (_now() - begin)*1e3);
+
+	//queries around random keys, some close to the line and some far off
+	std::vector<Bline::Point> queries(queryCounts);
+	srand(5);
+	for (size_t i = 0; i < queryCounts; i++) {
+		size_t k = (size_t)rand() % keyCounts;
+		Bline::Real r = (i % 2) ? 5 : 500;
+		queries[i].x = keys[k * 3 + 0] + _random(-r, r);
+		queries[i].y = keys[k * 3 + 1] + _random(-r, r);
+		queries[i].z = keys[k * 3 + 2] + _random(-r, r);
+	}
+
+	std::vector<Bline::Projection> results(queryCounts);
+	begin = _now();
+	for (size_t i = 0; i < queryCounts; i++) bline.project(queries[i], results[i]);
+	double bvh = (_now() - begin) / queryCounts;
+
+	size_t sampleCounts = (keyCounts - 2)*perPart;
+	std::vector<Bline::Real> t(sampleCounts), buf(sampleCounts * 6);
+	for (size_t i = 0; i < sampleCounts; i++) t[i] = (Bline::Real)i / (Bline::Real)(sampleCounts - 1);
+	Bline::Real* b = &buf[0];
+	Bline::PointArray points = { b, b + sampleCounts, b + sampleCounts * 2 };
+	Bline::PointArray tangents = { b + sampleCounts * 3, b + sampleCounts * 4, b + sampleCounts * 5 };
+	bline.getPoints(&t[0], sampleCounts, points, tangents);
+
+	begin = _now();
+	Bline::Real worse = 0, reprojection = 0;
+	for (size_t i = 0; i < queryCounts; i++) {
+		const Bline::Point& q = queries[i];
+		Bline::Real best = std::numeric_limits<Bline::Real>::infinity();
+		for (size_t k = 0; k < sampleCounts; k++) {
+			Bline::Real x = points.x[k] - q.x, y = points.y[k] - q.y, z = points.z[k] - q.z;
+			best = std::min(best, x*x + y*y + z*z);
+		}
+
+		//samples lie on the line, the exact distance is never larger
+		worse = std::max(worse, results[i].distance - sqrt(best));
+
+		Bline::Point pt, ta;
+		bline.getPoint(results[i].t, pt, ta);
+		reprojection = std::max(reprojection, (Bline::Real)(fabs(pt.x - results[i].point.x) + fabs(pt.y - results[i].point.y) + fabs(pt.z - results[i].point.z)));
+	}
+	double brute = (_now() - begin) / queryCounts;
+
+	printf("bvh project                    %10.3f us/query\n", bvh*1e6);
+	printf("brute force (%u smp/part)      %10.3f us/query, %.0fx\n", (unsigned int)perPart, brute*1e6, brute / bvh);
+	printf("worse than samples by          %10.3g\n", worse);
+	printf("getPoint(t) off the projection %10.3g\n", reprojection);
+}
+
+//--------------------------------------------------------------------------------------
+static void _benchBounds(void)
+{
+	const size_t keyCounts = 100002;
+	const size_t sampleCounts = 4000000;
+
+	printf("== bounds (%u parts)\n", (unsigned int)(keyCounts - 2));
+
+	//all coordinates negative, an empty max started at the smallest positive number
+	//would stay above every key
+	std::vector<Bline::Real> keys;
+	_randomKeys(keys, keyCounts, 1);
+	for (size_t i = 0; i < keys.size(); i++) keys[i] = -100000 + keys[i] * (Bline::Real)0.01;
+
+	Bline::Point keyMin, keyMax;
+	keyMin.x = keyMin.y = keyMin.z = std::numeric_limits<Bline::Real>::max();
+	keyMax.x = keyMax.y = keyMax.z = std::numeric_limits<Bline::Real>::lowest();
+	for (size_t i = 0; i < keyCounts; i++) {
+		keyMin.x = std::min(keyMin.x, keys[i * 3 + 0]); keyMax.x = std::max(keyMax.x, keys[i * 3 + 0]);
+		keyMin.y = std::min(keyMin.y, keys[i * 3 + 1]); keyMax.y = std::max(keyMax.y, keys[i * 3 + 1]);
+		keyMin.z = std::min(keyMin.z, keys[i * 3 + 2]); keyMax.z = std::max(keyMax.z, keys[i * 3 + 2]);
+	}
+
+	Bline bline;
+	bline.build(&keys[0], keyCounts);
+
+	Bline::Point min, max;
+	bline.getBounder(min, max);
+
+	//dense samples, each lies inside the box and together they reach its faces
+	std::vector<Bline::Real> t(sampleCounts), buf(sampleCounts * 6);
+	for (size_t i = 0; i < sampleCounts; i++) t[i] = (Bline::Real)i / (Bline::Real)(sampleCounts - 1);
+	Bline::Real* b = &buf[0];
+	Bline::PointArray points = { b, b + sampleCounts, b + sampleCounts * 2 };
+	Bline::PointArray tangents = { b + sampleCounts * 3, b + sampleCounts * 4, b + sampleCounts * 5 };
+	bline.getPoints(&t[0], sampleCounts, points, tangents);
+
+	Bline::Point sampleMin, sampleMax;
+	sampleMin.x = sampleMin.y = sampleMin.z = std::numeric_limits<Bline::Real>::max();
+	sampleMax.x = sampleMax.y = sampleMax.z = std::numeric_limits<Bline::Real>::lowest();
+	for (size_t i = 0; i < sampleCounts; i++) {
+		sampleMin.x = std::min(sampleMin.x, points.x[i]); sampleMax.x = std::max(sampleMax.x, points.x[i]);
+		sampleMin.y = std::min(sampleMin.y, points.y[i]); sampleMax.y = std::max(sampleMax.y, points.y[i]);
+		sampleMin.z = std::min(sampleMin.z, points.z[i]); sampleMax.z = std::max(sampleMax.z, points.z[i]);
+	}
+
+	//the boxes of the parts hold their own beziers, built from the keys the same way
+	Bline::Real outside = 0;
+	size_t partCounts = bline.getPartCounts();
+	for (size_t i = 0; i < partCounts; i += 7) {
+		Bline::Point partMin, partMax;
+		bline.getPartBounder(i, partMin, partMax);
+
+		for (int axis = 0; axis < 3; axis++) {
+			const Bline::Real* k = &keys[i * 3 + axis];
+			Bline::Real p0 = (i == 0) ? k[0] : (k[0] + k[3]) / 2;
+			Bline::Real p1 = k[3];
+			Bline::Real p2 = (i == partCounts - 1) ? k[6] : (k[3] + k[6]) / 2;
+			Bline::Real lo = (&partMin.x)[axis], hi = (&partMax.x)[axis];
+
+			for (int j = 0; j <= 256; j++) {
+				Bline::Real u = (Bline::Real)j / 256, u1 = 1 - u;
+				Bline::Real v = u1*u1*p0 + 2 * u*u1*p1 + u*u*p2;
+				outside = std::max(outside, std::max(lo - v, v - hi));
+			}
+		}
+	}
+
+	Bline::Real keyVolume = (keyMax.x - keyMin.x)*(keyMax.y - keyMin.y)*(keyMax.z - keyMin.z);
+	Bline::Real volume = (max.x - min.x)*(max.y - min.y)*(max.z - min.z);
+	Bline::Real slack = std::max(std::max(std::max(sampleMin.x - min.x, max.x - sampleMax.x), std::max(sampleMin.y - min.y, max.y - sampleMax.y)), std::max(sampleMin.z - min.z, max.z - sampleMax.z));
+	Bline::Real beyond = std::max(std::max(std::max(min.x - sampleMin.x, sampleMax.x - max.x), std::max(min.y - sampleMin.y, sampleMax.y - max.y)), std::max(min.z - sampleMin.z, sampleMax.z - max.z));
+
+	printf("key box max y                  %10.4f\n", keyMax.y);
+	printf("curve box max y                %10.4f\n", max.y);
+	printf("curve / key box volume         %10.4f\n", volume / keyVolume);
+	printf("box face beyond samples        %10.3g\n", slack);
+	printf("samples outside the box        %10.3g\n", std::max(beyond, outside));
+}
+
+//--------------------------------------------------------------------------------------
+static Bline::Real _polylineError(const Bline& bline, const std::vector<Bline::Real>& t, const Bline::PointArray& points, size_t counts)
+{
+	//curve samples inside every span against the chord of the span
+	const size_t inner = 7;
+	std::vector<Bline::Real> st((counts - 1)*inner), buf((counts - 1)*inner * 6);
+	for (size_t i = 0; i + 1 < counts; i++) {
+		for (size_t k = 0; k < inner; k++) st[i*inner + k] = t[i] + (t[i + 1] - t[i])*(Bline::Real)(k + 1) / (Bline::Real)(inner + 1);
+	}
+	size_t sampleCounts = st.size();
+	Bline::Real* b = &buf[0];
+	Bline::PointArray sp = { b, b + sampleCounts, b + sampleCounts * 2 };
+	Bline::PointArray sa = { b + sampleCounts * 3, b + sampleCounts * 4, b + sampleCounts * 5 };
+	bline.getPoints(&st[0], sampleCounts, sp, sa);
+
+	Bline::Real worst = 0;
+	for (size_t i = 0; i + 1 < counts; i++) {
+		Bline::Real dx = points.x[i + 1] - points.x[i], dy = points.y[i + 1] - points.y[i], dz = points.z[i + 1] - points.z[i];
+		Bline::Real dd = dx*dx + dy*dy + dz*dz;
+		for (size_t k = 0; k < inner; k++) {
+			size_t j = i*inner + k;
+			Bline::Real px = sp.x[j] - points.x[i], py = sp.y[j] - points.y[i], pz = sp.z[j] - points.z[i];
+			Bline::Real s = (dd > 0) ? std::max((Bline::Real)0, std::min((Bline::Real)1, (px*dx + py*dy + pz*dz) / dd)) : 0;
+			Bline::Real ex = px - s*dx, ey = py - s*dy, ez = pz - s*dz;
+			worst = std::max(worst, sqrt(ex*ex + ey*ey + ez*ez));
+		}
+	}
+	return worst;
+}
+
+//--------------------------------------------------------------------------------------
+static Bline::Real _uniformError(const Bline& bline, size_t counts)
+{
+	std::vector<Bline::Real> t(counts), buf(counts * 6);
+	for (size_t i = 0; i < counts; i++) t[i] = (Bline::Real)i / (Bline::Real)(counts - 1);
+	Bline::Real* b = &buf[0];
+	Bline::PointArray points = { b, b + counts, b + counts * 2 };
+	Bline::PointArray tangents = { b + counts * 3, b + counts * 4, b + counts * 5 };
+	bline.getPoints(&t[0], counts, points, tangents);
+	return _polylineError(bline, t, points, counts);
+}
+
+//--------------------------------------------------------------------------------------
+static void _benchTessellate(void)
+{
+	const size_t keyCounts = 10002;
+	const Bline::Real noise = (Bline::Real)0.05;
+
+	printf("== tessellate (%u parts, straight runs and random bends)\n", (unsigned int)(keyCounts - 2));
+
+	//half the keys on almost straight runs, half wandering
+	std::vector<Bline::Real> keys, bends;
+	_straightKeys(keys, keyCounts, noise, 3);
+	_randomKeys(bends, keyCounts, 3);
+	for (size_t i = keyCounts / 2; i < keyCounts; i++) {
+		for (int k = 0; k < 3; k++) keys[i * 3 + k] = keys[(keyCounts / 2 - 1) * 3 + k] + bends[(i - keyCounts / 2) * 3 + k] - bends[k];
+	}
+
+	Bline bline;
+	bline.build(&keys[0], keyCounts);
+
+	printf("   tolerance   adaptive(pts)   tess(us)     max error   uniform max error   uniform pts for it\n");
+	Bline::Real tolerances[] = { 1, (Bline::Real)0.1, (Bline::Real)0.01 };
+	for (size_t n = 0; n < sizeof(tolerances) / sizeof(tolerances[0]); n++) {
+		Bline::Real tolerance = tolerances[n];
+		Bline::PointArray none = { nullptr, nullptr, nullptr };
+		size_t counts = bline.tessellate(tolerance, none, 0);
+
+		std::vector<Bline::Real> t(counts), buf(counts * 3);
+		Bline::Real* b = &buf[0];
+		Bline::PointArray points = { b, b + counts, b + counts * 2 };
+
+		double begin = _now();
+		const int rounds = 20;
+		for (int r = 0; r < rounds; r++) bline.tessellate(tolerance, points, counts);
+		double tess = (_now() - begin) / rounds;
+		bline.tessellate(tolerance, points, counts, &t[0]);
+
+		Bline::Real error = _polylineError(bline, t, points, counts);
+		Bline::Real uniform = _uniformError(bline, counts);
+
+		//uniform arc-length samples needed for the same error, by doubling then bisection.
+		//16x the adaptive counts at most
+		size_t lo = counts, hi = counts;
+		while (hi < counts * 16 && _uniformError(bline, hi) > error) { lo = hi; hi *= 2; }
+		while (lo < hi && hi - lo > hi / 64) {
+			size_t mid = (lo + hi) / 2;
+			if (_uniformError(bline, mid) > error) lo = mid; else hi = mid;
+		}
+
+		printf("%12.3f %15u %10.1f %13.3g %19.3g %20u%s\n", tolerance, (unsigned int)counts, tess*1e6, error, uniform, (unsigned int)hi,
+			(hi >= counts * 16 && _uniformError(bline, hi) > error) ? "+" : "");
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// many short lines, one heap line each against a set sharing one arena
+//--------------------------------------------------------------------------------------
+class SizeAllocator : public BlineAllocator
+{
+public:
+	size_t counts;
+	size_t bytes;
+
+	SizeAllocator() : counts(0), bytes(0) {}
+	virtual void* allocate(size_t size, size_t alignment)
+	{
+		counts++;
+		bytes += size;
+		return BlineAllocator::getDefault()->allocate(size, alignment);
+	}
+	virtual void deallocate(void* p, size_t size, size_t alignment)
+	{
+		counts--;
+		bytes -= size;
+		BlineAllocator::getDefault()->deallocate(p, size, alignment);
+	}
+};
+
+static void _benchSet(void)
+{
+	const size_t lineCounts = 20000;
+	const size_t sampleCounts = 2000000;
+
+	//20 to 200 keys per line
+	std::vector<size_t> keyCounts(lineCounts);
+	std::vector<Bline::Real> keys;
+	srand(11);
+	size_t totalKeys = 0;
+	for (size_t i = 0; i < lineCounts; i++) {
+		keyCounts[i] = 20 + (size_t)rand() % 181;
+		totalKeys += keyCounts[i];
+	}
+	keys.reserve(totalKeys * 3);
+	for (size_t i = 0; i < lineCounts; i++) {
+		std::vector<Bline::Real> line;
+		_randomKeys(line, keyCounts[i], (unsigned int)i + 1);
+		keys.insert(keys.end(), line.begin(), line.end());
+	}
+
+	printf("== set (%u lines, %u keys)\n", (unsigned int)lineCounts, (unsigned int)totalKeys);
+
+	//one heap line each
+	SizeAllocator sizes;
+	std::vector<Bline*> lines(lineCounts);
+	size_t heapBegin = g_heapAllocs;
+	double begin = _now();
+	for (size_t i = 0, offset = 0; i < lineCounts; offset += keyCounts[i], i++) {
+		lines[i] = new Bline;
+		lines[i]->setAllocator(&sizes);
+		lines[i]->build(&keys[offset * 3], keyCounts[i]);
+	}
+	double buildLines = _now() - begin;
+	size_t linesAllocs = g_heapAllocs - heapBegin;
+	size_t linesBytes = sizes.bytes + lineCounts*sizeof(Bline) + lineCounts*sizeof(Bline*);
+
+	//one arena, built twice so the second build runs in the merged block
+	BlineSet set;
+	set.build(&keys[0], &keyCounts[0], lineCounts);
+	heapBegin = g_heapAllocs;
+	begin = _now();
+	set.build(&keys[0], &keyCounts[0], lineCounts);
+	double buildSet = _now() - begin;
+	size_t setAllocs = g_heapAllocs - heapBegin;
+	size_t arenaBytes, arenaUsed;
+	set.getArenaInfo(arenaBytes, arenaUsed);
+	size_t setBytes = arenaBytes + lineCounts*(sizeof(Bline) + sizeof(size_t));
+
+	//the same random (line, t) pairs for both, then sorted by line and t as a renderer
+	//walks them
+	std::vector<size_t> which(sampleCounts);
+	std::vector<Bline::Real> t(sampleCounts), buf(sampleCounts * 6);
+	for (size_t i = 0; i < sampleCounts; i++) {
+		which[i] = (size_t)rand() % lineCounts;
+		t[i] = _random(0, 1);
+	}
+	Bline::Real* b = &buf[0];
+	Bline::PointArray points = { b, b + sampleCounts, b + sampleCounts * 2 };
+	Bline::PointArray tangents = { b + sampleCounts * 3, b + sampleCounts * 4, b + sampleCounts * 5 };
+
+	double sampleLines[2], sampleSet[2];
+	Bline::Real diff = 0;
+	for (int sorted = 0; sorted < 2; sorted++) {
+		if (sorted) {
+			std::vector<size_t> order(sampleCounts);
+			for (size_t i = 0; i < sampleCounts; i++) order[i] = i;
+			std::sort(order.begin(), order.end(), [&](size_t a, size_t c) { return (which[a] != which[c]) ? which[a] < which[c] : t[a] < t[c]; });
+			std::vector<size_t> w(sampleCounts);
+			std::vector<Bline::Real> u(sampleCounts);
+			for (size_t i = 0; i < sampleCounts; i++) { w[i] = which[order[i]]; u[i] = t[order[i]]; }
+			which.swap(w);
+			t.swap(u);
+		}
+
+		begin = _now();
+		for (size_t i = 0; i < sampleCounts; i++) {
+			Bline::Point pt, ta;
+			lines[which[i]]->getPoint(t[i], pt, ta);
+			points.x[i] = pt.x; points.y[i] = pt.y; points.z[i] = pt.z;
+		}
+		sampleLines[sorted] = (_now() - begin) / sampleCounts;
+		std::vector<Bline::Real> x(points.x, points.x + sampleCounts);
+
+		begin = _now();
+		set.getPoints(&which[0], &t[0], sampleCounts, points, tangents);
+		sampleSet[sorted] = (_now() - begin) / sampleCounts;
+
+		for (size_t i = 0; i < sampleCounts; i++) diff = std::max(diff, (Bline::Real)fabs(x[i] - points.x[i]));
+	}
+
+	printf("%-22s %12s %12s %14s %14s %14s\n", "", "bytes/line", "heap allocs", "build(ms)", "random(ns)", "sorted(ns)");
+	printf("%-22s %12.0f %12u %14.2f %14.1f %14.1f\n", "vector<Bline*>", (double)linesBytes / lineCounts, (unsigned int)linesAllocs,
+		buildLines*1e3, sampleLines[0] * 1e9, sampleLines[1] * 1e9);
+	printf("%-22s %12.0f %12u %14.2f %14.1f %14.1f\n", "BlineSet", (double)setBytes / lineCounts, (unsigned int)setAllocs,
+		buildSet*1e3, sampleSet[0] * 1e9, sampleSet[1] * 1e9);
+	printf("arena used %.1f%%, max difference %g\n", 100.0*arenaUsed / arenaBytes, diff);
+
+	for (size_t i = 0; i < lineCounts; i++) delete lines[i];
+}
+
+//--------------------------------------------------------------------------------------
+// rotation minimizing frames in one walk, against getPoint per frame
+//--------------------------------------------------------------------------------------
+static void _benchFrames(void)
+{
+	const size_t keyCounts = 100002;
+	const Bline::Real step = (Bline::Real)1.0;
+
+	std::vector<Bline::Real> keys;
+	_randomKeys(keys, keyCounts, 1);
+
+	Bline bline;
+	bline.build(&keys[0], keyCounts);
+
+	Bline::Point up = { 0, 1, 0 };
+	Bline::PointArray none = { nullptr, nullptr, nullptr };
+	size_t counts = bline.getFrames(step, up, none, none, none, 0);
+
+	printf("== frames (%u parts, %u frames)\n", (unsigned int)(keyCounts - 2), (unsigned int)counts);
+
+	std::vector<Bline::Real> buf(counts * 9);
+	Bline::Real* b = &buf[0];
+	Bline::PointArray points = { b, b + counts, b + counts * 2 };
+	Bline::PointArray tangents = { b + counts * 3, b + counts * 4, b + counts * 5 };
+	Bline::PointArray normals = { b + counts * 6, b + counts * 7, b + counts * 8 };
+
+	double begin = _now();
+	bline.getFrames(step, up, points, tangents, normals, counts);
+	double walk = _now() - begin;
+
+	//the same frames from one independent getPoint each
+	std::vector<Bline::Real> naive(counts * 3);
+	Bline::Real total = bline.getTotalLength();
+	begin = _now();
+	Bline::Point last = { 0, 0, 0 }, lastTangent = { 0, 0, 0 }, normal = { 0, 0, 0 };
+	for (size_t i = 0; i < counts; i++) {
+		Bline::Real s = (i + 1 < counts) ? (Bline::Real)i * step : total;
+		Bline::Point pt, ta;
+		bline.getPoint(std::min(s / total, (Bline::Real)1), pt, ta);
+
+		if (i == 0) {
+			normal.x = normals.x[0]; normal.y = normals.y[0]; normal.z = normals.z[0];
+		}
+		else {
+			Bline::Real v1[3] = { pt.x - last.x, pt.y - last.y, pt.z - last.z };
+			Bline::Real c1 = v1[0] * v1[0] + v1[1] * v1[1] + v1[2] * v1[2];
+			Bline::Real r = 2 * (v1[0] * normal.x + v1[1] * normal.y + v1[2] * normal.z) / c1;
+			Bline::Real t = 2 * (v1[0] * lastTangent.x + v1[1] * lastTangent.y + v1[2] * lastTangent.z) / c1;
+			Bline::Point rL = { normal.x - r*v1[0], normal.y - r*v1[1], normal.z - r*v1[2] };
+			Bline::Point tL = { lastTangent.x - t*v1[0], lastTangent.y - t*v1[1], lastTangent.z - t*v1[2] };
+			Bline::Real v2[3] = { ta.x - tL.x, ta.y - tL.y, ta.z - tL.z };
+			Bline::Real c2 = v2[0] * v2[0] + v2[1] * v2[1] + v2[2] * v2[2];
+			Bline::Real r2 = (c2 > 0) ? 2 * (v2[0] * rL.x + v2[1] * rL.y + v2[2] * rL.z) / c2 : 0;
+			normal.x = rL.x - r2*v2[0]; normal.y = rL.y - r2*v2[1]; normal.z = rL.z - r2*v2[2];
+		}
+		naive[i * 3 + 0] = normal.x; naive[i * 3 + 1] = normal.y; naive[i * 3 + 2] = normal.z;
+		last = pt;
+		lastTangent = ta;
+	}
+	double lookup = _now() - begin;
+
+	//frames stay orthonormal, and the walk lands where getPoint does
+	Bline::Real orthogonal = 0, unit = 0, position = 0, twist = 0;
+	for (size_t i = 0; i < counts; i += 13) {
+		Bline::Real s = (i + 1 < counts) ? (Bline::Real)i * step : total;
+		Bline::Point pt, ta;
+		bline.getPoint(std::min(s / total, (Bline::Real)1), pt, ta);
+		position = std::max(position, (Bline::Real)(fabs(pt.x - points.x[i]) + fabs(pt.y - points.y[i]) + fabs(pt.z - points.z[i])));
+
+		orthogonal = std::max(orthogonal, (Bline::Real)fabs(normals.x[i] * tangents.x[i] + normals.y[i] * tangents.y[i] + normals.z[i] * tangents.z[i]));
+		unit = std::max(unit, (Bline::Real)fabs(sqrt(normals.x[i] * normals.x[i] + normals.y[i] * normals.y[i] + normals.z[i] * normals.z[i]) - 1));
+		twist = std::max(twist, (Bline::Real)(fabs(naive[i * 3] - normals.x[i]) + fabs(naive[i * 3 + 1] - normals.y[i]) + fabs(naive[i * 3 + 2] - normals.z[i])));
+	}
+
+	printf("one walk                       %10.3f Mframes/s\n", counts / walk * 1e-6);
+	printf("getPoint per frame             %10.3f Mframes/s, %.1fx\n", counts / lookup * 1e-6, lookup / walk);
+	printf("point off getPoint             %10.3g\n", position);
+	printf("|n.t|, ||n|-1|                 %10.3g %10.3g\n", orthogonal, unit);
+	printf("normal off the lookup frames   %10.3g\n", twist);
+}
+
+//--------------------------------------------------------------------------------------
+// tubes and ribbons streamed through fixed chunk buffers
+//--------------------------------------------------------------------------------------
+static void _benchMesh(void)
+{
+	const size_t keyCounts = 1000000;
+	const size_t chunkVertices = 65536;
+	const size_t chunkIndices = chunkVertices * 6;
+
+	printf("== mesh (%u keys, chunks of %u vertices)\n", (unsigned int)keyCounts, (unsigned int)chunkVertices);
+
+	std::vector<Bline::Real> keys;
+	_randomKeys(keys, keyCounts, 1);
+	Bline bline;
+	bline.build(&keys[0], keyCounts);
+
+	std::vector<BlineMesh::Vertex> vertices(chunkVertices);
+	std::vector<uint32_t> indices(chunkIndices);
+	printf("chunk buffers                  %10.2f MB\n", (vertices.size()*sizeof(BlineMesh::Vertex) + indices.size()*sizeof(uint32_t)) / 1048576.0);
+	printf("%-16s %10s %12s %12s %8s %12s %12s\n", "shape", "rings", "vertices", "triangles", "chunks", "Mvert/s", "heap allocs");
+
+	const char* names[] = { "tube, 16 sides", "ribbon" };
+	for (int shape = 0; shape < 2; shape++) {
+		BlineMesh mesh;
+		mesh.setShape(shape ? BlineMesh::MS_RIBBON : BlineMesh::MS_TUBE);
+		mesh.setSides(16);
+		mesh.setRadius(2);
+		mesh.setStep(shape ? (Bline::Real)2 : (Bline::Real)10);
+
+		size_t meshVertices, meshIndices;
+		mesh.getMeshCounts(bline, meshVertices, meshIndices);
+
+		size_t heapBegin = g_heapAllocs;
+		size_t totalVertices = 0, totalIndices = 0, chunks = 0;
+		double checksum = 0;
+		double begin = _now();
+		mesh.begin(bline);
+		size_t vertexCounts, indexCounts;
+		while (mesh.next(&vertices[0], chunkVertices, &indices[0], chunkIndices, vertexCounts, indexCounts)) {
+			totalVertices += vertexCounts;
+			totalIndices += indexCounts;
+			chunks++;
+			//touch the chunk as an upload would
+			checksum += vertices[vertexCounts - 1].position[0] + indices[indexCounts - 1];
+		}
+		double time = _now() - begin;
+		size_t heapAllocs = g_heapAllocs - heapBegin;
+
+		//the first ring of a chunk repeats the last one of the chunk before
+		size_t rings = (totalVertices - (chunks - 1)*mesh.getRingVertexCounts()) / mesh.getRingVertexCounts();
+		printf("%-16s %10u %12u %12u %8u %12.2f %12u%s\n", names[shape], (unsigned int)rings, (unsigned int)totalVertices,
+			(unsigned int)(totalIndices / 3), (unsigned int)chunks, totalVertices / time * 1e-6, (unsigned int)heapAllocs,
+			(totalIndices == meshIndices && totalVertices == meshVertices + (chunks - 1)*mesh.getRingVertexCounts()) ? "" : " MISMATCH");
+		(void)checksum;
+	}
+
+	//a tube of a short line meshed in one chunk and in chunks of three rings gives the same
+	//vertices, ring for ring
+	Bline small;
+	small.build(&keys[0], 1000);
+	BlineMesh mesh;
+	mesh.setSides(12);
+	size_t meshVertices, meshIndices;
+	mesh.getMeshCounts(small, meshVertices, meshIndices);
+	std::vector<BlineMesh::Vertex> whole(meshVertices);
+	std::vector<uint32_t> wholeIndices(meshIndices);
+	size_t vertexCounts, indexCounts;
+	mesh.begin(small);
+	mesh.next(&whole[0], meshVertices, &wholeIndices[0], meshIndices, vertexCounts, indexCounts);
+
+	size_t ring = mesh.getRingVertexCounts();
+	std::vector<BlineMesh::Vertex> part(ring * 3);
+	std::vector<uint32_t> partIndices(mesh.getSpanIndexCounts() * 2);
+	float diff = 0, normal = 0;
+	size_t at = 0;
+	mesh.begin(small);
+	while (mesh.next(&part[0], part.size(), &partIndices[0], partIndices.size(), vertexCounts, indexCounts)) {
+		if (at > 0) at -= ring;
+		for (size_t i = 0; i < vertexCounts; i++, at++) {
+			for (int k = 0; k < 3; k++) diff = std::max(diff, fabsf(part[i].position[k] - whole[at].position[k]));
+		}
+	}
+	for (size_t i = 0; i < meshVertices; i++) {
+		const float* n = whole[i].normal;
+		normal = std::max(normal, fabsf(sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) - 1));
+	}
+	printf("chunked against one chunk      %10.3g (%u of %u vertices)\n", diff, (unsigned int)at, (unsigned int)meshVertices);
+	printf("||normal|-1|                   %10.3g\n", normal);
+}
+
+//--------------------------------------------------------------------------------------
+// agents moving along a line every tick, cursors against one getPoint per agent
+//--------------------------------------------------------------------------------------
+static void _benchCursor(void)
+{
+	const size_t keyCounts = 100002;
+	const size_t agentCounts = 100000;
+	const size_t tickCounts = 100;
+	const Bline::Real dt = (Bline::Real)1.0 / 60;
+
+	printf("== cursor (%u parts, %u agents, %u ticks)\n", (unsigned int)(keyCounts - 2), (unsigned int)agentCounts, (unsigned int)tickCounts);
+
+	std::vector<Bline::Real> keys;
+	_randomKeys(keys, keyCounts, 1);
+	Bline bline;
+	bline.build(&keys[0], keyCounts);
+	Bline::Real total = bline.getTotalLength();
+
+	//agents speed up or slow down, and turn around at the ends
+	std::vector<Bline::Cursor> cursors(agentCounts);
+	srand(9);
+	for (size_t i = 0; i < agentCounts; i++) {
+		bline.setCursor(_random(0, total), cursors[i]);
+		cursors[i].speed = _random(-300, 300);
+		cursors[i].acceleration = _random(-20, 20);
+	}
+	std::vector<Bline::Cursor> start = cursors;
+
+	Bline::Point pt, ta;
+	double sum = 0;
+	double begin = _now();
+	for (size_t tick = 0; tick < tickCounts; tick++) {
+		for (size_t i = 0; i < agentCounts; i++) {
+			Bline::Cursor& c = cursors[i];
+			if (!bline.advanceTime(c, dt, pt, ta)) c.speed = -c.speed;
+			sum += pt.x;
+		}
+	}
+	double cursor = (_now() - begin) / (tickCounts*agentCounts);
+
+	//the same motion, a getPoint from the length every tick
+	std::vector<Bline::Real> length(agentCounts), speed(agentCounts);
+	for (size_t i = 0; i < agentCounts; i++) {
+		length[i] = start[i].length;
+		speed[i] = start[i].speed;
+	}
+	begin = _now();
+	for (size_t tick = 0; tick < tickCounts; tick++) {
+		for (size_t i = 0; i < agentCounts; i++) {
+			Bline::Real a = start[i].acceleration;
+			Bline::Real l = length[i] + speed[i] * dt + a*dt*dt / 2;
+			speed[i] += a*dt;
+			if (l <= 0 || l >= total) {
+				l = std::min(std::max(l, (Bline::Real)0), total);
+				speed[i] = -speed[i];
+			}
+			length[i] = l;
+			bline.getPoint(l / total, pt, ta);
+			sum += pt.x;
+		}
+	}
+	double lookup = (_now() - begin) / (tickCounts*agentCounts);
+
+	//where the cursors ended up against getPoint at their lengths
+	Bline::Real position = 0, drift = 0;
+	for (size_t i = 0; i < agentCounts; i++) {
+		Bline::Point cp, ct;
+		bline.advance(cursors[i], 0, cp, ct);
+		bline.getPoint(cursors[i].length / total, pt, ta);
+		position = std::max(position, (Bline::Real)(fabs(pt.x - cp.x) + fabs(pt.y - cp.y) + fabs(pt.z - cp.z)));
+		drift = std::max(drift, (Bline::Real)fabs(cursors[i].length - length[i]));
+	}
+
+	printf("cursor advance                 %10.1f ns/agent tick\n", cursor*1e9);
+	printf("getPoint per tick              %10.1f ns/agent tick, %.1fx\n", lookup*1e9, lookup / cursor);
+	printf("point off getPoint             %10.3g\n", position);
+	printf("length off the getPoint run    %10.3g\n", drift);
+	if (sum == 0) printf("\n");
+}
+
+//--------------------------------------------------------------------------------------
+// arc length queries, single and sorted batches, against dense getPoint sampling
+//--------------------------------------------------------------------------------------
+static void _benchQuery(void)
+{
+	const size_t keyCounts = 100002;
+	const size_t queryCounts = 1000000;
+
+	printf("== query (%u parts, %u queries)\n", (unsigned int)(keyCounts - 2), (unsigned int)queryCounts);
+
+	std::vector<Bline::Real> keys;
+	_randomKeys(keys, keyCounts, 1);
+	Bline bline;
+	bline.build(&keys[0], keyCounts);
+	Bline::Real total = bline.getTotalLength();
+	Bline::Real parts = (Bline::Real)bline.getPartCounts();
+
+	std::vector<Bline::Real> params(queryCounts), lengths(queryCounts), out(queryCounts), batch(queryCounts);
+	srand(4);
+	for (size_t i = 0; i < queryCounts; i++) {
+		params[i] = _random(0, parts);
+		lengths[i] = _random(0, total);
+	}
+
+	double begin = _now();
+	for (size_t i = 0; i < queryCounts; i++) out[i] = bline.getLength(params[i]);
+	double lengthRandom = (_now() - begin) / queryCounts;
+
+	begin = _now();
+	for (size_t i = 0; i < queryCounts; i++) out[i] = bline.getParam(lengths[i]);
+	double paramRandom = (_now() - begin) / queryCounts;
+
+	std::sort(params.begin(), params.end());
+	std::sort(lengths.begin(), lengths.end());
+
+	begin = _now();
+	for (size_t i = 0; i < queryCounts; i++) out[i] = bline.getLength(params[i]);
+	double lengthSorted = (_now() - begin) / queryCounts;
+	begin = _now();
+	bline.getLengths(&params[0], queryCounts, &batch[0]);
+	double lengthBatch = (_now() - begin) / queryCounts;
+	Bline::Real lengthDiff = 0;
+	for (size_t i = 0; i < queryCounts; i++) lengthDiff = std::max(lengthDiff, (Bline::Real)fabs(out[i] - batch[i]));
+
+	begin = _now();
+	for (size_t i = 0; i < queryCounts; i++) out[i] = bline.getParam(lengths[i]);
+	double paramSorted = (_now() - begin) / queryCounts;
+	begin = _now();
+	bline.getParams(&lengths[0], queryCounts, &batch[0]);
+	double paramBatch = (_now() - begin) / queryCounts;
+	Bline::Real paramDiff = 0;
+	for (size_t i = 0; i < queryCounts; i++) paramDiff = std::max(paramDiff, (Bline::Real)fabs(out[i] - batch[i]));
+
+	//length back from the parameter
+	Bline::Real roundTrip = 0;
+	for (size_t i = 0; i < queryCounts; i += 7) {
+		roundTrip = std::max(roundTrip, (Bline::Real)fabs(bline.getLength(batch[i]) - lengths[i]));
+	}
+
+	//the old way, chords of dense samples
+	const size_t sampleCounts = 4000000;
+	begin = _now();
+	Bline::Point last, pt, ta;
+	Bline::Real chords = 0;
+	bline.getPoint(0, last, ta);
+	for (size_t i = 1; i < sampleCounts; i++) {
+		bline.getPoint((Bline::Real)i / (Bline::Real)(sampleCounts - 1), pt, ta);
+		chords += sqrt((pt.x - last.x)*(pt.x - last.x) + (pt.y - last.y)*(pt.y - last.y) + (pt.z - last.z)*(pt.z - last.z));
+		last = pt;
+	}
+	double dense = _now() - begin;
+
+	printf("%-28s %12s %12s %12s\n", "ns/query", "random", "sorted", "sorted batch");
+	printf("%-28s %12.1f %12.1f %12.1f\n", "getLength(param)", lengthRandom*1e9, lengthSorted*1e9, lengthBatch*1e9);
+	printf("%-28s %12.1f %12.1f %12.1f\n", "getParam(length)", paramRandom*1e9, paramSorted*1e9, paramBatch*1e9);
+	printf("batch off single               %10.3g (lengths) %10.3g (params)\n", lengthDiff, paramDiff);
+	printf("getLength(getParam(s)) - s     %10.3g\n", roundTrip);
+	printf("dense chords, %u samples  %10.1f ms, total off by %.3g\n", (unsigned int)sampleCounts, dense*1e3, total - chords);
+
+	//lengths past the end, on power of two part counts the length tree has no padding
+	bool clamped = true;
+	for (size_t parts = 1; parts <= 64; parts *= 2) {
+		Bline small;
+		small.build(&keys[0], parts + 2);
+		Bline::Real past[3] = { small.getTotalLength(), small.getTotalLength() * 2, std::numeric_limits<Bline::Real>::infinity() };
+		Bline::Real out3[3];
+		small.getParams(past, 3, out3);
+		for (int i = 0; i < 3; i++) {
+			Bline::Real param;
+			size_t part = small.getPartAt(past[i], param);
+			clamped = clamped && part == parts - 1 && param == (Bline::Real)1.0 && out3[i] == (Bline::Real)parts;
+		}
+	}
+	printf("lengths past the end clamped   %10s\n", clamped ? "yes" : "NO");
+}
+
+//--------------------------------------------------------------------------------------
+// cold start from mapped images against building from keys
+//--------------------------------------------------------------------------------------
+struct MappedFile
+{
+	const void* data;
+	size_t bytes;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int file;
+#endif
+};
+
+//--------------------------------------------------------------------------------------
+static bool _mapFile(const char* path, MappedFile& map)
+{
+#ifdef _WIN32
+	map.file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (map.file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size;
+	GetFileSizeEx(map.file, &size);
+	map.bytes = (size_t)size.QuadPart;
+	map.mapping = CreateFileMappingA(map.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	map.data = map.mapping ? MapViewOfFile(map.mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+	map.file = open(path, O_RDONLY);
+	if (map.file < 0) return false;
+	struct stat st;
+	fstat(map.file, &st);
+	map.bytes = (size_t)st.st_size;
+	map.data = mmap(nullptr, map.bytes, PROT_READ, MAP_PRIVATE, map.file, 0);
+	if (map.data == MAP_FAILED) map.data = nullptr;
+#endif
+	return map.data != nullptr;
+}
+
+//--------------------------------------------------------------------------------------
+static void _unmapFile(MappedFile& map)
+{
+#ifdef _WIN32
+	if (map.data) UnmapViewOfFile(map.data);
+	if (map.mapping) CloseHandle(map.mapping);
+	CloseHandle(map.file);
+#else
+	if (map.data) munmap((void*)map.data, map.bytes);
+	close(map.file);
+#endif
+	map.data = nullptr;
+}
+
+//--------------------------------------------------------------------------------------
+static bool _dropFileCache(const char* path)
+{
+	//so the first samples really come from the disk, where the system lets us
+#if defined(POSIX_FADV_DONTNEED)
+	int file = open(path, O_RDONLY);
+	if (file < 0) return false;
+	fsync(file);
+	bool dropped = posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED) == 0;
+	close(file);
+	return dropped;
+#else
+	(void)path;
+	return false;
+#endif
+}
+
+//--------------------------------------------------------------------------------------
+static void _benchImage(void)
+{
+	const size_t lineCounts = 20;
+	const size_t keyCounts = 50000;
+	const size_t sampleCounts = 1000;
+	const char* path = "bl_bench.image";
+
+	printf("== image (%u lines of %u keys, %u samples per line)\n", (unsigned int)lineCounts, (unsigned int)keyCounts, (unsigned int)sampleCounts);
+	printf("%-12s %10s %12s %12s %12s %12s %8s\n", "", "MB", "build(ms)", "load(ms)", "first(ms)", "start(ms)", "same");
+
+	std::vector<std::vector<Bline::Real>> keys(lineCounts);
+	for (size_t i = 0; i < lineCounts; i++) _randomKeys(keys[i], keyCounts, (unsigned int)(i + 1));
+
+	std::vector<Bline::Real> t(sampleCounts), buf(sampleCounts * 6), ref(lineCounts * sampleCounts * 6);
+	for (size_t i = 0; i < sampleCounts; i++) t[i] = (Bline::Real)i / (Bline::Real)(sampleCounts - 1);
+	Bline::PointArray points = { &buf[0], &buf[sampleCounts], &buf[sampleCounts * 2] };
+	Bline::PointArray tangents = { &buf[sampleCounts * 3], &buf[sampleCounts * 4], &buf[sampleCounts * 5] };
+
+	bool dropped = true;
+	bool deterministic = true;
+	for (int fast = 0; fast < 2; fast++) {
+		//the usual start, every line built from its keys, then sampled once
+		std::vector<Bline> built(lineCounts);
+		double begin = _now();
+		for (size_t i = 0; i < lineCounts; i++) {
+			built[i].setFastInvert(fast != 0);
+			built[i].build(&keys[i][0], keyCounts);
+		}
+		double build = _now() - begin;
+		begin = _now();
+		for (size_t i = 0; i < lineCounts; i++) {
+			built[i].getPoints(&t[0], sampleCounts, points, tangents);
+			memcpy(&ref[i*sampleCounts * 6], &buf[0], sampleCounts * 6 * sizeof(Bline::Real));
+		}
+		double buildFirst = _now() - begin;
+
+		//all images in one file, each on an aligned offset
+		std::vector<size_t> offsets(lineCounts + 1, 0);
+		for (size_t i = 0; i < lineCounts; i++) {
+			size_t bytes = built[i].getImageBytes();
+			offsets[i + 1] = offsets[i] + ((bytes + Bline::IMAGE_ALIGNMENT - 1) & ~(size_t)(Bline::IMAGE_ALIGNMENT - 1));
+		}
+		std::vector<char> file(offsets[lineCounts] + Bline::IMAGE_ALIGNMENT);
+		char* image = &file[0] + (Bline::IMAGE_ALIGNMENT - ((uintptr_t)&file[0] & (Bline::IMAGE_ALIGNMENT - 1))) % Bline::IMAGE_ALIGNMENT;
+		for (size_t i = 0; i < lineCounts; i++) {
+			built[i].saveImage(image + offsets[i], offsets[i + 1] - offsets[i]);
+		}
+
+		//a line built again, on reused heap, gives the same bytes
+		{
+			Bline again;
+			again.setFastInvert(fast != 0);
+			again.build(&keys[0][0], keyCounts);
+			std::vector<char> bytes(offsets[1] + Bline::IMAGE_ALIGNMENT, 1);
+			char* at = &bytes[0] + (Bline::IMAGE_ALIGNMENT - ((uintptr_t)&bytes[0] & (Bline::IMAGE_ALIGNMENT - 1))) % Bline::IMAGE_ALIGNMENT;
+			again.saveImage(at, offsets[1]);
+			deterministic = deterministic && memcmp(at, image, again.getImageBytes()) == 0;
+		}
+		FILE* f = fopen(path, "wb");
+		if (f == nullptr) {
+			printf("cannot write %s\n", path);
+			return;
+		}
+		fwrite(image, 1, offsets[lineCounts], f);
+		fclose(f);
+		built.clear();
+		dropped = _dropFileCache(path) && dropped;
+
+		const char* name = fast ? "fast invert" : "newton";
+		double mb = (double)offsets[lineCounts] / (1024.0 * 1024.0);
+		printf("%-12s %10.1f %12.2f %12s %12.2f %12.2f %8s\n", name, mb, build*1e3, "", buildFirst*1e3, (build + buildFirst)*1e3, "");
+
+		//the mapped start, nothing is read before the samples touch it. first from the
+		//disk, then again from the page cache as a restart finds it
+		for (int warm = 0; warm < 2; warm++) {
+			MappedFile map = {};
+			std::vector<Bline> loaded(lineCounts);
+			begin = _now();
+			bool ok = _mapFile(path, map);
+			for (size_t i = 0; ok && i < lineCounts; i++) {
+				ok = loaded[i].loadImage((const char*)map.data + offsets[i], offsets[i + 1] - offsets[i]);
+			}
+			double load = _now() - begin;
+			if (!ok) {
+				printf("cannot map or load %s\n", path);
+				return;
+			}
+
+			bool same = true;
+			begin = _now();
+			for (size_t i = 0; i < lineCounts; i++) {
+				loaded[i].getPoints(&t[0], sampleCounts, points, tangents);
+				same = same && memcmp(&ref[i*sampleCounts * 6], &buf[0], sampleCounts * 6 * sizeof(Bline::Real)) == 0;
+			}
+			double loadFirst = _now() - begin;
+
+			//a loaded line is read only
+			Bline::Point key = { 0, 0, 0 };
+			same = same && !loaded[0].setKey(0, key) && !loaded[0].appendKey(key);
+
+			printf("%-12s %10s %12s %12.3f %12.2f %12.2f %8s\n", warm ? "  mapped warm" : "  mapped cold", "", "", load*1e3, loadFirst*1e3, (load + loadFirst)*1e3, same ? "yes" : "NO");
+
+			loaded.clear();
+			_unmapFile(map);
+		}
+	}
+	remove(path);
+	printf("images of a rebuild identical  %s\n", deterministic ? "yes" : "NO");
+	printf("page cache %s before the cold mapping\n", dropped ? "dropped" : "NOT dropped, cold times are warm");
+}
+
+//--------------------------------------------------------------------------------------
+// Entry
+//--------------------------------------------------------------------------------------
+struct Bench
+{
+	const char* name;
+	void(*func)(void);
+};
+
+static const Bench g_benches[] = {
+	{ "batch", _benchBatch },
+	{ "search", _benchSearch },
+	{ "fastinvert", _benchFastInvert },
+	{ "latency", _benchLatency },
+	{ "straight", _benchStraight },
+	{ "length", _benchLength },
+	{ "simd", _benchSimd },
+	{ "float", _benchFloat },
+	{ "edit", _benchEdit },
+	{ "append", _benchAppend },
+	{ "build", _benchBuild },
+	{ "stride", _benchStride },
+	{ "alloc", _benchAlloc },
+	{ "share", _benchShare },
+	{ "publish", _benchPublish },
+	{ "project", _benchProject },
+	{ "bounds", _benchBounds },
+	{ "tessellate", _benchTessellate },
+	{ "set", _benchSet },
+	{ "frames", _benchFrames },
+	{ "mesh", _benchMesh },
+	{ "cursor", _benchCursor },
+	{ "query", _benchQuery },
+	{ "image", _benchImage },
+};
+
+int main(int argc, char* argv[])
+{
+	const size_t benchCounts = sizeof(g_benches) / sizeof(g_benches[0]);
+
+	for (size_t i = 0; i < benchCounts; i++) {
+		if (argc > 1 && strcmp(argv[1], g_benches[i].name) != 0) continue;
+		g_benches[i].func();
+	}
+	return 0;
+}
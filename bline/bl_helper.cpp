@@ -53,7 +53,8 @@ BlineHelper::BlineHelper()
 	, m_tangentLength(3.0f)
 	, m_legendCounts(50)
 	, m_linePointVertexBuffer(nullptr)
-	, m_linePointCounts(100)
+	, m_linePointCounts(0)
+	, m_lineTolerance(0.01f)
 {
 
 }
@@ -273,18 +274,24 @@ HRESULT BlineHelper::_buildLinePointVertexBuffer(ID3D11Device* pd3dDevice, const
 {
 	HRESULT hr;
 
+	//adaptive polyline, few points on straight runs and more in the bends
+	Bline::PointArray none = { nullptr, nullptr, nullptr };
+	m_linePointCounts = bline->tessellate((Bline::Real)m_lineTolerance, none, 0);
+	if (m_linePointCounts == 0) return S_OK;
+
+	Bline::Real* buf = new Bline::Real[m_linePointCounts * 3];
+	Bline::PointArray pt = { buf, buf + m_linePointCounts, buf + m_linePointCounts * 2 };
+	bline->tessellate((Bline::Real)m_lineTolerance, pt, m_linePointCounts);
+
 	LineVertex* pts = new LineVertex[m_linePointCounts];
 	for (size_t i = 0; i < m_linePointCounts; i++) {
-		Bline::Real t = (Bline::Real)i / (Bline::Real)(m_linePointCounts - 1);
-		Bline::Point pt, ta;
-		bline->getPoint(t, pt, ta);
-
-		pts[i].Pos.x = (float)pt.x;
-		pts[i].Pos.y = (float)pt.y;
-		pts[i].Pos.z = (float)pt.z;
+		pts[i].Pos.x = (float)pt.x[i];
+		pts[i].Pos.y = (float)pt.y[i];
+		pts[i].Pos.z = (float)pt.z[i];
 		pts[i].Color = XMFLOAT4(1.0f, 1.0f, 0.0f, 1.0f);
-
 	}
+	delete[] buf;
+
 	D3D11_BUFFER_DESC bd;
 	ZeroMemory(&bd, sizeof(bd));
 	bd.Usage = D3D11_USAGE_DEFAULT;
@@ -307,23 +314,29 @@ HRESULT BlineHelper::_buildLegendVertexBuffer(ID3D11Device* pd3dDevice, const Bl
 {
 	HRESULT hr;
 
-	LineVertex* pts = new LineVertex[m_legendCounts*2];
+	Bline::Real* buf = new Bline::Real[m_legendCounts * 7];
+	Bline::Real* t = buf;
+	Bline::PointArray pt = { buf + m_legendCounts, buf + m_legendCounts * 2, buf + m_legendCounts * 3 };
+	Bline::PointArray ta = { buf + m_legendCounts * 4, buf + m_legendCounts * 5, buf + m_legendCounts * 6 };
+
 	for (size_t i = 0; i < m_legendCounts; i++) {
-		Bline::Real t = (Bline::Real)i / (Bline::Real)(m_legendCounts - 1);
-		Bline::Point pt, ta;
-		bline->getPoint(t, pt, ta);
+		t[i] = (Bline::Real)i / (Bline::Real)(m_legendCounts - 1);
+	}
+	bline->getPoints(t, m_legendCounts, pt, ta);
 
-		pts[i*2].Pos.x = (float)pt.x;
-		pts[i*2].Pos.y = (float)pt.y;
-		pts[i*2].Pos.z = (float)pt.z;
+	LineVertex* pts = new LineVertex[m_legendCounts*2];
+	for (size_t i = 0; i < m_legendCounts; i++) {
+		pts[i*2].Pos.x = (float)pt.x[i];
+		pts[i*2].Pos.y = (float)pt.y[i];
+		pts[i*2].Pos.z = (float)pt.z[i];
 		pts[i*2].Color = XMFLOAT4(0.0f, 1.0f, 0.0f, 1.0f);
 
-		pts[i * 2+1].Pos.x = (float)pt.x+(float)ta.x*m_tangentLength;
-		pts[i * 2+1].Pos.y = (float)pt.y+(float)ta.y*m_tangentLength;
-		pts[i * 2+1].Pos.z = (float)pt.z+(float)ta.z*m_tangentLength;
+		pts[i * 2+1].Pos.x = (float)pt.x[i]+(float)ta.x[i]*m_tangentLength;
+		pts[i * 2+1].Pos.y = (float)pt.y[i]+(float)ta.y[i]*m_tangentLength;
+		pts[i * 2+1].Pos.z = (float)pt.z[i]+(float)ta.z[i]*m_tangentLength;
 		pts[i * 2+1].Color = XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f);
 	}
-
+	delete[] buf;
 
 	D3D11_BUFFER_DESC bd;
 	ZeroMemory(&bd, sizeof(bd));
@@ -4,7 +4,8 @@
 
 using namespace DirectX;
 
-class Bline;
+template<typename T> class BlineT;
+typedef BlineT<double> Bline;
 
 class BlineHelper
 {
@@ -74,6 +75,7 @@ private:
 
 	ID3D11Buffer*				m_linePointVertexBuffer;
 	size_t						m_linePointCounts;
+	float						m_lineTolerance;	//chord error of the line
 
 	bool						m_bRenderKey;
 	bool						m_bRenderSegment;
@@ -1,51 +1,258 @@
 #include "bl_line.h"
+#include "bl_simd.h"
 #include <assert.h>
 #include <float.h>
+#include <cstddef>
+#include <limits>
+#include <string.h>
 #include <complex>
+#include <vector>
+#include <thread>
+#include <utility>
+
+//--------------------------------------------------------------------------------------
+//run func(thread, begin, end) on even ranges of [0, counts), the first range on the calling thread
+template<typename F>
+static void _parallelFor(size_t threads, size_t counts, F func)
+{
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < threads; i++) {
+		workers.push_back(std::thread(func, i, counts*i / threads, counts*(i + 1) / threads));
+	}
+	func((size_t)0, (size_t)0, counts / threads);
+
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+}
+
+//--------------------------------------------------------------------------------------
+class BlineDefaultAllocator : public BlineAllocator
+{
+public:
+	virtual void* allocate(size_t bytes, size_t alignment);
+	virtual void deallocate(void* p, size_t bytes, size_t alignment);
+};
+
+//--------------------------------------------------------------------------------------
+void* BlineDefaultAllocator::allocate(size_t bytes, size_t alignment)
+{
+	assert((alignment & (alignment - 1)) == 0);
+	if (alignment <= alignof(std::max_align_t)) return ::operator new(bytes);
+
+	//over-aligned, padded by the alignment. the offset to the block is kept just before the
+	//pointer, there is room for it since new gives max_align_t alignment at least
+	char* block = (char*)::operator new(bytes + alignment);
+	char* p = block + alignment - ((uintptr_t)block & (alignment - 1));
+	((size_t*)p)[-1] = (size_t)(p - block);
+	return p;
+}
+
 //--------------------------------------------------------------------------------------
-Bline::Bline()
+void BlineDefaultAllocator::deallocate(void* p, size_t, size_t alignment)
+{
+	if (alignment <= alignof(std::max_align_t)) {
+		::operator delete(p);
+		return;
+	}
+	::operator delete((char*)p - ((size_t*)p)[-1]);
+}
+
+//--------------------------------------------------------------------------------------
+BlineAllocator* BlineAllocator::getDefault(void)
+{
+	static BlineDefaultAllocator s_allocator;
+	return &s_allocator;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+BlineT<T>::BlineT()
 	: m_keyPoints(nullptr)
 	, m_keyCounts(0)
+	, m_keyCapacity(0)
 	, m_parts(nullptr)
+	, m_partControls(nullptr)
 	, m_partCounts(0)
+	, m_totalLength((Real)0.0)
+	, m_bvh(nullptr)
+	, m_bvhLeaves(0)
+	, m_lengthTree(nullptr)
+	, m_lengthTreeSize(0)
+	, m_lengthMode(LM_SPATIAL)
+	, m_maxIterations(32)
+	, m_threadCounts(1)
+	, m_allocator(BlineAllocator::getDefault())
+	, m_fastInvert(false)
+	, m_fastInvertPolish(false)
+	, m_fastInvertError((Real)0.0001)
+	, m_invertTable(nullptr)
+	, m_invertTableSize(0)
+	, m_invertTableCapacity(0)
+	, m_invertTableError((Real)0.0)
+	, m_invertNewtonParts(0)
+	, m_image(false)
 {
 
 }
 
 //--------------------------------------------------------------------------------------
-Bline::~Bline()
+template<typename T>
+BlineT<T>::BlineT(BlineT&& other) noexcept
+	: BlineT()
 {
-	release();
+	_swap(other);
 }
 
 //--------------------------------------------------------------------------------------
-void Bline::release(void)
+template<typename T>
+BlineT<T>& BlineT<T>::operator=(BlineT&& other) noexcept
 {
-	if (m_keyPoints) {
-		delete[] m_keyPoints;
-		m_keyPoints = 0;
+	//the old memory is freed now, other is left empty as by the move constructor and keeps
+	//the settings and the allocator of this line
+	if (this != &other) {
+		release();
+		_swap(other);
 	}
+	return *this;
+}
 
-	m_keyCounts = 0;
+//--------------------------------------------------------------------------------------
+template<typename T>
+BlineT<T>::~BlineT()
+{
+	release();
+}
 
-	if (sizeof(Real) == sizeof(float)) {
-		m_bounderMin.x = m_bounderMin.y = m_bounderMin.z = (Real)FLT_MAX;
-		m_bounderMax.x = m_bounderMax.y = m_bounderMax.z = (Real)FLT_MIN;
-	}
-	else if(sizeof(Real) == sizeof(double)) {
-		m_bounderMin.x = m_bounderMin.y = m_bounderMin.z = (Real)DBL_MAX;
-		m_bounderMax.x = m_bounderMax.y = m_bounderMax.z = (Real)DBL_MIN;
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_swap(BlineT& other)
+{
+	std::swap(m_keyPoints, other.m_keyPoints);
+	std::swap(m_keyCounts, other.m_keyCounts);
+	std::swap(m_keyCapacity, other.m_keyCapacity);
+	std::swap(m_parts, other.m_parts);
+	std::swap(m_partControls, other.m_partControls);
+	std::swap(m_partCounts, other.m_partCounts);
+	std::swap(m_totalLength, other.m_totalLength);
+	std::swap(m_bvh, other.m_bvh);
+	std::swap(m_bvhLeaves, other.m_bvhLeaves);
+	std::swap(m_lengthTree, other.m_lengthTree);
+	std::swap(m_lengthTreeSize, other.m_lengthTreeSize);
+	std::swap(m_lengthMode, other.m_lengthMode);
+	std::swap(m_maxIterations, other.m_maxIterations);
+	std::swap(m_threadCounts, other.m_threadCounts);
+	std::swap(m_allocator, other.m_allocator);
+	std::swap(m_fastInvert, other.m_fastInvert);
+	std::swap(m_fastInvertPolish, other.m_fastInvertPolish);
+	std::swap(m_fastInvertError, other.m_fastInvertError);
+	std::swap(m_invertTable, other.m_invertTable);
+	std::swap(m_invertTableSize, other.m_invertTableSize);
+	std::swap(m_invertTableCapacity, other.m_invertTableCapacity);
+	std::swap(m_invertTableError, other.m_invertTableError);
+	std::swap(m_invertNewtonParts, other.m_invertNewtonParts);
+	std::swap(m_image, other.m_image);
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+typename BlineT<T>::Snapshot BlineT<T>::share(void)
+{
+	std::shared_ptr<BlineT> snapshot = std::make_shared<BlineT>(std::move(*this));
+
+	//the new line has the settings of this one, give them back
+	m_lengthMode = snapshot->m_lengthMode;
+	m_maxIterations = snapshot->m_maxIterations;
+	m_threadCounts = snapshot->m_threadCounts;
+	m_allocator = snapshot->m_allocator;
+	m_fastInvert = snapshot->m_fastInvert;
+	m_fastInvertPolish = snapshot->m_fastInvertPolish;
+	m_fastInvertError = snapshot->m_fastInvertError;
+	return snapshot;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+template<typename U>
+U* BlineT<T>::_allocate(size_t counts) const
+{
+	return (U*)m_allocator->allocate(counts*sizeof(U), alignof(U));
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+template<typename U>
+void BlineT<T>::_deallocate(U*& p, size_t counts) const
+{
+	if (p) {
+		m_allocator->deallocate(p, counts*sizeof(U), alignof(U));
+		p = 0;
 	}
+}
 
-	if (m_parts) {
-		delete[] m_parts;
-		m_parts = 0;
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::release(void)
+{
+	//an image belongs to the caller, only forget it
+	if (m_image) {
+		m_keyPoints = nullptr;
+		m_parts = nullptr;
+		m_partControls = nullptr;
+		m_lengthTree = nullptr;
+		m_bvh = nullptr;
+		m_invertTable = nullptr;
+		m_keyCapacity = m_lengthTreeSize = m_bvhLeaves = m_invertTableCapacity = 0;
+		m_image = false;
 	}
+
+	//parts and controls share the capacity of the keys
+	_deallocate(m_keyPoints, m_keyCapacity);
+	_deallocate(m_parts, m_keyCapacity);
+	_deallocate(m_partControls, m_keyCapacity);
+	m_keyCapacity = 0;
+
+	_deallocate(m_lengthTree, m_lengthTreeSize);
+	m_lengthTreeSize = 0;
+
+	_deallocate(m_bvh, m_bvhLeaves * 2);
+	m_bvhLeaves = 0;
+
+	_deallocate(m_invertTable, m_invertTableCapacity);
+	m_invertTableCapacity = 0;
+
+	_reset();
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_reset(void)
+{
+	m_keyCounts = 0;
 	m_partCounts = 0;
+	m_totalLength = (Real)0.0;
+
+	//a table left from an earlier build would turn the refit of setKey on
+	if (!m_fastInvert) {
+		_deallocate(m_invertTable, m_invertTableCapacity);
+		m_invertTableCapacity = 0;
+	}
+	m_invertTableSize = 0;
+	m_invertTableError = (Real)0.0;
+	m_invertNewtonParts = 0;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::setAllocator(BlineAllocator* allocator)
+{
+	release();
+	m_allocator = allocator ? allocator : BlineAllocator::getDefault();
 }
 
 //--------------------------------------------------------------------------------------
-void Bline::_middle(const Point& pt1, const Point& pt2, Point& middle)
+template<typename T>
+void BlineT<T>::_middle(const Point& pt1, const Point& pt2, Point& middle)
 {
 	middle.x = (pt1.x + pt2.x) / 2.f;
 	middle.y = (pt1.y + pt2.y) / 2.f;
@@ -53,7 +260,8 @@ void Bline::_middle(const Point& pt1, const Point& pt2, Point& middle)
 }
 
 //--------------------------------------------------------------------------------------
-void Bline::_normalize(Point& vector)
+template<typename T>
+void BlineT<T>::_normalize(Point& vector)
 {
 	Real length = vector.x*vector.x + vector.y*vector.y + vector.z*vector.z;
 	if (length < (Real)0.0000001) return;
@@ -65,8 +273,30 @@ void Bline::_normalize(Point& vector)
 }
 
 //--------------------------------------------------------------------------------------
-Bline::Real Bline::_getlength(const LinePart& lp, Real t)
+template<typename T>
+T BlineT<T>::_getlength(const LinePart& lp, Real t)
 {
+	if (lp.type == PT_STRAIGHT) {
+		Real c0, k;
+		_getStraightSpeed(lp, c0, k);
+
+		//speed |c0 + k*t|, may turn back once at t0
+		if (k < (Real)0.0 && c0 < -k*t) {
+			Real t0 = c0 / -k;
+			return c0*t0 / 2 - k*(t - t0)*(t - t0) / 2;
+		}
+		return c0*t + k*t*t / 2;
+	}
+
+	if (lp.type == PT_NEAR_STRAIGHT) {
+		//speed is smooth here since its minimum is far outside [0, 1]
+		return _getQuadratureLength(lp, (Real)0.0, t);
+	}
+
+	if (lp.type == PT_QUADRATURE) {
+		return _getCompositeLength(lp, t, 4);
+	}
+
 	const Real& A = lp.A;
 	const Real& B = lp.B;
 	const Real& C = lp.C;
@@ -81,147 +311,1876 @@ Bline::Real Bline::_getlength(const LinePart& lp, Real t)
 }
 
 //--------------------------------------------------------------------------------------
-bool Bline::build(const Real* keyPoints, unsigned int keyCounts)
+template<typename T>
+T BlineT<T>::_getQuadratureLength(const LinePart& lp, Real t0, Real t1)
 {
-	release();
+	//8 points gauss-legendre
+	static const Real x[4] = { (Real)0.1834346424956498, (Real)0.5255324099163290, (Real)0.7966664774136267, (Real)0.9602898564975363 };
+	static const Real w[4] = { (Real)0.3626837833783620, (Real)0.3137066458778873, (Real)0.2223810344533745, (Real)0.1012285362903763 };
+
+	Real half = (t1 - t0) / 2;
+	Real middle = (t0 + t1) / 2;
+	Real sum = (Real)0.0;
+	for (int i = 0; i < 4; i++) {
+		sum += w[i] * (_getSpeed(lp, middle - half*x[i]) + _getSpeed(lp, middle + half*x[i]));
+	}
+	return sum*half;
+}
 
-	assert(keyCounts >=3);
+//--------------------------------------------------------------------------------------
+template<typename T>
+T BlineT<T>::_getCompositeLength(const LinePart& lp, Real t, size_t panels)
+{
+	//split where the speed is lowest, the integrand has a kink there when the part turns sharply
+	Real split = (lp.A > (Real)0.0) ? -lp.B / (2 * lp.A) : (Real)-1.0;
+	if (!(split > (Real)0.0 && split < t)) split = t;
 
-	m_keyCounts = keyCounts;
-	m_keyPoints = new Point[keyCounts];
+	Real length = (Real)0.0;
+	for (size_t i = 0; i < panels; i++) {
+		length += _getQuadratureLength(lp, split*i / panels, split*(i + 1) / panels);
+		if (split < t) {
+			length += _getQuadratureLength(lp, split + (t - split)*i / panels, split + (t - split)*(i + 1) / panels);
+		}
+	}
+	return length;
+}
 
-	const Real* k = keyPoints;
-	for (unsigned int i = 0; i < keyCounts; i++) {
-		Real& x = m_keyPoints[i].x = *k++;
-		Real& y = m_keyPoints[i].y = *k++;
-		Real& z = m_keyPoints[i].z = *k++;
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_getStraightSpeed(const LinePart& lp, Real& c0, Real& k)
+{
+	//first order expansion of sqrt(C + B*t + A*t*t), exact for collinear control points
+	c0 = lp.sqrt_C;
+	k = (lp.C > (Real)0.0) ? lp.B / (2 * lp.sqrt_C) : lp.sqrt_A;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+T BlineT<T>::_getStraightInvert(const LinePart& lp, Real length)
+{
+	Real c0, k;
+	_getStraightSpeed(lp, c0, k);
 
-		if (x > m_bounderMax.x) m_bounderMax.x = x;
-		if (x < m_bounderMin.x) m_bounderMin.x = x;
-		if (y > m_bounderMax.y) m_bounderMax.y = y;
-		if (y < m_bounderMin.y) m_bounderMin.y = y;
-		if (z > m_bounderMax.z) m_bounderMax.z = z;
-		if (z < m_bounderMin.z) m_bounderMin.z = z;
+	if (k < (Real)0.0 && c0 < -k) {
+		Real t0 = c0 / -k;
+		Real length0 = c0*t0 / 2;
+		if (length > length0) {
+			return t0 + sqrt(2 * (length - length0) / -k);
+		}
 	}
 
-	m_totalLength = (Real)0.0;
+	//root of k*t*t/2 + c0*t - length, in the form without cancellation
+	Real d = c0*c0 + 2 * k*length;
+	Real denom = c0 + sqrt(d > (Real)0.0 ? d : (Real)0.0);
+	return (denom > (Real)0.0) ? 2 * length / denom : (Real)0.0;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+bool BlineT<T>::build(const Real* keyPoints, size_t keyCounts)
+{
+	return build(keyPoints, 3 * sizeof(Real), (sizeof(Real) == sizeof(float)) ? CT_FLOAT : CT_DOUBLE, keyCounts);
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+bool BlineT<T>::build(const void* base, size_t stride, ComponentType type, size_t keyCounts)
+{
+	if (keyCounts < 3) return false;
+
+	if (m_image) release();
+	_reset();
+
+	_reserveKeys(keyCounts);
+	m_keyCounts = keyCounts;
 	m_partCounts = keyCounts - 2;
-	m_parts = new LinePart[m_partCounts];
-	for (size_t i = 0; i < m_partCounts; i++) {
-		LinePart& lp = m_parts[i];
 
-		if (i == 0) {
-			lp.pt0 = m_keyPoints[i];
+	size_t threads = _getThreadCounts(keyCounts);
+
+	_parallelFor(threads, keyCounts, [&](size_t, size_t begin, size_t end) {
+		const char* k = (const char*)base + begin*stride;
+		for (size_t i = begin; i < end; i++, k += stride) {
+			if (type == CT_FLOAT) {
+				m_keyPoints[i].x = (Real)((const float*)k)[0];
+				m_keyPoints[i].y = (Real)((const float*)k)[1];
+				m_keyPoints[i].z = (Real)((const float*)k)[2];
+			}
+			else {
+				m_keyPoints[i].x = (Real)((const double*)k)[0];
+				m_keyPoints[i].y = (Real)((const double*)k)[1];
+				m_keyPoints[i].z = (Real)((const double*)k)[2];
+			}
 		}
-		else {
-			_middle(m_keyPoints[i], m_keyPoints[i + 1], lp.pt0);
+	});
+
+	_parallelFor(threads, m_partCounts, [&](size_t, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			_buildPart(i);
+			m_parts[i].invertOffset = m_parts[i].invertCounts = 0;
 		}
+	});
+
+	_buildLengthTree(threads);
+	m_totalLength = _getStartLength(m_partCounts);
+
+	_buildBvh(threads);
+
+	if (m_fastInvert) {
+		_buildInvertTable(threads);
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_buildPart(size_t index)
+{
+	LinePart& lp = m_parts[index];
+	PartControl& pc = m_partControls[index];
+
+	if (index == 0) {
+		pc.pt0 = m_keyPoints[index];
+	}
+	else {
+		_middle(m_keyPoints[index], m_keyPoints[index + 1], pc.pt0);
+	}
+
+	pc.pt1 = m_keyPoints[index + 1];
+
+	if (index == m_partCounts - 1) {
+		pc.pt2 = m_keyPoints[index + 2];
+	}
+	else {
+		_middle(m_keyPoints[index + 1], m_keyPoints[index + 2], pc.pt2);
+	}
 
-		lp.pt1 = m_keyPoints[i + 1];
+	Real ax = pc.pt0.x - 2 * pc.pt1.x + pc.pt2.x;
+	Real ay = pc.pt0.y - 2 * pc.pt1.y + pc.pt2.y;
+	Real az = pc.pt0.z - 2 * pc.pt1.z + pc.pt2.z;
+	Real bx = 2 * pc.pt1.x - 2 * pc.pt0.x;
+	Real by = 2 * pc.pt1.y - 2 * pc.pt0.y;
+	Real bz = 2 * pc.pt1.z - 2 * pc.pt0.z;
+	if (m_lengthMode == LM_PLANAR) {
+		az = bz = (Real)0.0;
+	}
+
+	lp.A = 4 * (ax*ax + ay*ay + az*az);
+	lp.B = 4 * (ax*bx + ay*by + az*bz);
+	lp.C = bx*bx + by*by + bz*bz;
+	lp.sqrt_A = sqrt(lp.A);
+	lp.sqrt_C = sqrt(lp.C);
+	lp.E = (lp.B*lp.B - 4*lp.A*lp.C);
+
+	//-E/4C is the part of A not explained by a straight motion
+	if (-lp.E <= BlineTraits<Real>::straightEpsilon() * 4 * lp.C*(lp.A + lp.C)) {
+		lp.type = PT_STRAIGHT;
+		lp.D = (Real)0.0;
+	}
+	else if (m_lengthMode == LM_QUADRATURE) {
+		lp.type = PT_QUADRATURE;
+		lp.D = (Real)0.0;
+	}
+	else if (lp.A <= BlineTraits<Real>::nearStraightRatio() * lp.C) {
+		lp.type = PT_NEAR_STRAIGHT;
+		lp.D = (Real)0.0;
+	}
+	else {
+		lp.type = PT_GENERAL;
+		lp.D = log(lp.B + 2 * lp.sqrt_A*lp.sqrt_C);
+	}
+
+	lp.length = _getlength(lp, (Real)1.0);
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+size_t BlineT<T>::_getThreadCounts(size_t counts) const
+{
+	//below some thousand keys per thread the thread start costs more than it saves
+	const size_t minCounts = 4096;
+
+	size_t threads = m_threadCounts;
+	if (threads == 0) threads = std::thread::hardware_concurrency();
+	if (threads > MAX_THREADS) threads = MAX_THREADS;
+	if (threads > counts / minCounts) threads = counts / minCounts;
+	return (threads > 0) ? threads : 1;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_buildLengthTree(size_t threads)
+{
+	_reserveLengthTree(m_partCounts);
+
+	//a tree kept from a longer line has old parts past the end
+	for (size_t j = m_partCounts; j < m_lengthTreeSize; j++) {
+		m_lengthTree[j] = std::numeric_limits<Real>::infinity();
+	}
 
-		if (i == m_partCounts - 1) {
-			lp.pt2 = m_keyPoints[i + 2];
+	//node j (one based) holds the lengths of the parts (j - lowbit(j), j], and is the sum of
+	//its own part and its children j - lowbit(j)/2 ... j-1, added in this order.
+	//the nodes are split into aligned blocks of a power of two, every node but the last of a
+	//block has all its children inside the block, so the blocks are built in parallel.
+	//the last nodes of the blocks are then done in order, the same additions in the same
+	//order for any thread counts
+	size_t blockSize = 1;
+	while (blockSize * 2 <= m_partCounts / threads) blockSize *= 2;
+	size_t blockCounts = (m_partCounts + blockSize - 1) / blockSize;
+
+	_parallelFor(threads, blockCounts, [&](size_t, size_t begin, size_t end) {
+		for (size_t b = begin; b < end; b++) {
+			size_t first = b*blockSize + 1;
+			size_t last = (b + 1)*blockSize;
+			if (last > m_partCounts) last = m_partCounts;
+
+			for (size_t j = first; j <= last; j++) {
+				m_lengthTree[j - 1] = m_parts[j - 1].length;
+			}
+			for (size_t j = first; j <= last; j++) {
+				size_t parent = j + (j & (~j + 1));
+				if (parent < (b + 1)*blockSize && parent <= m_partCounts) m_lengthTree[parent - 1] += m_lengthTree[j - 1];
+			}
 		}
-		else {
-			_middle(m_keyPoints[i + 1], m_keyPoints[i + 2], lp.pt2);
+	});
+
+	for (size_t j = blockSize; j <= m_partCounts; j += blockSize) {
+		Real length = m_parts[j - 1].length;
+		for (size_t k = (j & (~j + 1)) / 2; k > 0; k /= 2) {
+			length += m_lengthTree[j - k - 1];
 		}
+		m_lengthTree[j - 1] = length;
+	}
+}
 
-		Real ax = lp.pt0.x - 2 * lp.pt1.x + lp.pt2.x;
-		Real ay = lp.pt0.y - 2 * lp.pt1.y + lp.pt2.y;
-		Real bx = 2 * lp.pt1.x - 2 * lp.pt0.x;
-		Real by = 2 * lp.pt1.y - 2 * lp.pt0.y;
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_getPartBox(const PartControl& pc, Box& box)
+{
+	//the ends, and per axis the one turning point where the derivative
+	//2(1-t)(p1-p0) + 2t(p2-p1) is zero, t = (p0-p1)/(p0-2p1+p2)
+	box.min = box.max = pc.pt0;
+	_expandBounder(pc.pt2, box.min, box.max);
 
-		lp.A = 4 * (ax*ax + ay*ay);
-		lp.B = 4 * (ax*bx + ay*by);
-		lp.C = bx*bx + by*by;
-		lp.sqrt_A = sqrt(lp.A);
-		lp.sqrt_C = sqrt(lp.C);
-		lp.D = log(lp.B + 2 * lp.sqrt_A*lp.sqrt_C);
-		lp.E = (lp.B*lp.B - 4*lp.A*lp.C);
+	const Real* p0 = &pc.pt0.x;
+	const Real* p1 = &pc.pt1.x;
+	const Real* p2 = &pc.pt2.x;
+	Real* boxMin = &box.min.x;
+	Real* boxMax = &box.max.x;
+	for (int axis = 0; axis < 3; axis++) {
+		Real a = p0[axis] - 2 * p1[axis] + p2[axis];
+		if (a == (Real)0.0) continue;
 
-		lp.length = _getlength(lp, (Real)1.0);
+		Real t = (p0[axis] - p1[axis]) / a;
+		if (!(t > (Real)0.0 && t < (Real)1.0)) continue;
 
-		m_totalLength += lp.length;
+		Real t1 = 1 - t;
+		Real v = t1*t1*p0[axis] + 2 * t*t1*p1[axis] + t*t*p2[axis];
+		if (v < boxMin[axis]) boxMin[axis] = v;
+		if (v > boxMax[axis]) boxMax[axis] = v;
 	}
+}
 
-	Real lengthAddup = (Real)0.0;
-	for (size_t i = 0; i < m_partCounts; i++) {
-		LinePart& lp = m_parts[i];
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_mergeBox(const Box& a, const Box& b, Box& box)
+{
+	//empty boxes have min above max, so they drop out here
+	box.min.x = (a.min.x < b.min.x) ? a.min.x : b.min.x;
+	box.min.y = (a.min.y < b.min.y) ? a.min.y : b.min.y;
+	box.min.z = (a.min.z < b.min.z) ? a.min.z : b.min.z;
+	box.max.x = (a.max.x > b.max.x) ? a.max.x : b.max.x;
+	box.max.y = (a.max.y > b.max.y) ? a.max.y : b.max.y;
+	box.max.z = (a.max.z > b.max.z) ? a.max.z : b.max.z;
+}
 
-		lengthAddup += lp.length;
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_buildBvh(size_t threads)
+{
+	size_t leaves = 1;
+	while (leaves < m_partCounts) leaves *= 2;
 
-		lp.percent = lp.length / m_totalLength;
-		lp.percentAddup = lengthAddup / m_totalLength;
+	if (leaves > m_bvhLeaves) {
+		_deallocate(m_bvh, m_bvhLeaves * 2);
+		m_bvhLeaves = leaves;
+		m_bvh = _allocate<Box>(m_bvhLeaves * 2);
+	}
+
+	Box empty;
+	empty.min.x = empty.min.y = empty.min.z = std::numeric_limits<Real>::infinity();
+	empty.max.x = empty.max.y = empty.max.z = -std::numeric_limits<Real>::infinity();
+
+	_parallelFor(threads, m_partCounts, [&](size_t, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			_getPartBox(m_partControls[i], m_bvh[m_bvhLeaves + i]);
+		}
+	});
+	for (size_t i = m_partCounts; i < m_bvhLeaves; i++) {
+		m_bvh[m_bvhLeaves + i] = empty;
+	}
+	//node 0 is not part of the tree, it is set only so images of a line are the same bytes
+	m_bvh[0] = empty;
+
+	for (size_t node = m_bvhLeaves - 1; node > 0; node--) {
+		_mergeBox(m_bvh[node * 2], m_bvh[node * 2 + 1], m_bvh[node]);
 	}
-	return true;
 }
 
 //--------------------------------------------------------------------------------------
-void Bline::getBounder(Point& min, Point& max) const
+template<typename T>
+void BlineT<T>::_updateBvh(size_t index)
 {
-	min = m_bounderMin;
-	max = m_bounderMax;
+	size_t node = m_bvhLeaves + index;
+	_getPartBox(m_partControls[index], m_bvh[node]);
+
+	for (node /= 2; node > 0; node /= 2) {
+		_mergeBox(m_bvh[node * 2], m_bvh[node * 2 + 1], m_bvh[node]);
+	}
 }
 
 //--------------------------------------------------------------------------------------
-Bline::Real Bline::_getInvertLength(const LinePart& lp, Real t, Real length) 
+template<typename T>
+void BlineT<T>::_expandBounder(const Point& point, Point& min, Point& max)
 {
-	Bline::Real t1 = t, t2;
+	if (point.x > max.x) max.x = point.x;
+	if (point.x < min.x) min.x = point.x;
+	if (point.y > max.y) max.y = point.y;
+	if (point.y < min.y) min.y = point.y;
+	if (point.z > max.z) max.z = point.z;
+	if (point.z < min.z) min.z = point.z;
+}
 
-	do {
-		t2 = t1 - (_getlength(lp, t1) - length) / sqrt(lp.A*t1*t1 + lp.B*t1 + lp.C);
-		if (fabs((t1 - t2))<0.000001) break;
-		t1 = t2;
-	} while (true);
-	return t2;
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_reserveKeys(size_t keyCounts)
+{
+	if (keyCounts <= m_keyCapacity) return;
+
+	//exact on the first build, doubling when appended to
+	size_t capacity = (m_keyCapacity * 2 > keyCounts) ? m_keyCapacity * 2 : keyCounts;
+
+	Point* keyPoints = _allocate<Point>(capacity);
+	LinePart* parts = _allocate<LinePart>(capacity);
+	PartControl* partControls = _allocate<PartControl>(capacity);
+	if (m_keyCounts > 0) memcpy(keyPoints, m_keyPoints, m_keyCounts*sizeof(Point));
+	if (m_partCounts > 0) {
+		memcpy(parts, m_parts, m_partCounts*sizeof(LinePart));
+		memcpy(partControls, m_partControls, m_partCounts*sizeof(PartControl));
+	}
+	//parts are only ever written member by member, so their padding stays zero and images
+	//of the same line are the same bytes
+	memset(parts + m_partCounts, 0, (capacity - m_partCounts)*sizeof(LinePart));
+
+	_deallocate(m_keyPoints, m_keyCapacity);
+	_deallocate(m_parts, m_keyCapacity);
+	_deallocate(m_partControls, m_keyCapacity);
+	m_keyPoints = keyPoints;
+	m_parts = parts;
+	m_partControls = partControls;
+	m_keyCapacity = capacity;
 }
 
 //--------------------------------------------------------------------------------------
-void Bline::getPoint(Real t, Point& point, Point& tangent) const
+template<typename T>
+void BlineT<T>::_reserveLengthTree(size_t partCounts)
 {
-	assert(t >= (Real)0.0 && t <= (Real)1.0);
+	if (m_lengthTree && partCounts <= m_lengthTreeSize) return;
 
-	if (t <= (Real)0.0) {
-		point = m_keyPoints[0];
-		tangent.x = -2 * point.x + 2 * m_keyPoints[1].x;
-		tangent.y = -2 * point.y + 2 * m_keyPoints[1].y;
-		tangent.z = -2 * point.z + 2 * m_keyPoints[1].z;
-		_normalize(tangent);
-		return;
+	size_t size = (m_lengthTreeSize > 0) ? m_lengthTreeSize : 1;
+	while (size < partCounts) size *= 2;
+
+	//nodes past the last part are infinite, the descent of _findPart never enters them
+	Real* lengthTree = _allocate<Real>(size);
+	if (m_lengthTreeSize > 0) memcpy(lengthTree, m_lengthTree, m_lengthTreeSize*sizeof(Real));
+	for (size_t j = m_lengthTreeSize; j < size; j++) {
+		lengthTree[j] = std::numeric_limits<Real>::infinity();
 	}
 
-	size_t partIndex = m_partCounts;
-	for (size_t i = 0; i < m_partCounts; i++) {
-		if (m_parts[i].percentAddup >= t) {
-			partIndex = i;
-			break;
+	_deallocate(m_lengthTree, m_lengthTreeSize);
+	m_lengthTree = lengthTree;
+	m_lengthTreeSize = size;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_addPartLength(size_t index, Real delta)
+{
+	for (size_t j = index + 1; j <= m_partCounts; j += (j & (~j + 1))) {
+		m_lengthTree[j - 1] += delta;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_setPartLength(size_t index)
+{
+	//node of a new last part, its children are the nodes j-1, j-2, j-4 ... below lowbit(j),
+	//amortized O(1) since half of the nodes have no child at all
+	size_t j = index + 1;
+	Real length = m_parts[index].length;
+	for (size_t k = 1; k < (j & (~j + 1)); k *= 2) {
+		length += m_lengthTree[j - k - 1];
+	}
+	m_lengthTree[j - 1] = length;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+bool BlineT<T>::setKey(size_t index, const Point& point)
+{
+	if (m_keyPoints == nullptr || index >= m_keyCounts || m_image) return false;
+
+	m_keyPoints[index] = point;
+	if (m_partCounts == 0) return true;
+
+	//key i is used by the parts i-2, i-1 and i
+	size_t first = (index >= 2) ? index - 2 : 0;
+	size_t last = (index < m_partCounts) ? index : m_partCounts - 1;
+
+	for (size_t i = first; i <= last; i++) {
+		LinePart& lp = m_parts[i];
+		Real length = lp.length;
+		bool newton = (m_invertTable && lp.type != PT_STRAIGHT && lp.invertCounts == 0);
+
+		_buildPart(i);
+		_addPartLength(i, lp.length - length);
+		_updateBvh(i);
+
+		if (m_invertTable) {
+			_refitInvertTable(i, newton);
 		}
 	}
 
-	if (partIndex >= m_partCounts) {
-		point = m_keyPoints[m_keyCounts - 1];
-		tangent.x = -2 * m_keyPoints[m_keyCounts - 2].x + 2 * point.x;
-		tangent.y = -2 * m_keyPoints[m_keyCounts - 2].y + 2 * point.y;
-		tangent.z = -2 * m_keyPoints[m_keyCounts - 2].z + 2 * point.z;
-		_normalize(tangent);
-		return;
+	m_totalLength = _getStartLength(m_partCounts);
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+bool BlineT<T>::appendKey(const Point& point)
+{
+	if (m_image) return false;
+
+	_reserveKeys(m_keyCounts + 1);
+	m_keyPoints[m_keyCounts++] = point;
+
+	if (m_keyCounts < 3) return true;
+
+	size_t index = m_keyCounts - 3;
+	m_partCounts = m_keyCounts - 2;
+	_reserveLengthTree(m_partCounts);
+
+	//a table is only started with the first part, parts built without one were never fitted
+	//and keep using Newton until the next build()
+	if (m_fastInvert && m_invertTable == nullptr && index == 0) {
+		_reserveInvertTable(64);
 	}
 
-	const LinePart& lp = m_parts[partIndex];
-	Real start_percent = (partIndex == 0) ? (Real)0.0 : m_parts[partIndex - 1].percentAddup;
+	_buildPart(index);
+	m_parts[index].invertOffset = m_invertTableSize;
+	m_parts[index].invertCounts = 0;
 
-	Real percent = (t - start_percent) / lp.percent;
-	Real length = percent*lp.length;
-	t = _getInvertLength(lp, percent, length);
+	//the old last part ended on the old last key, now it ends on a middle point
+	if (index > 0) {
+		LinePart& lp = m_parts[index - 1];
+		Real length = lp.length;
+		bool newton = (m_invertTable && lp.type != PT_STRAIGHT && lp.invertCounts == 0);
 
-	point.x = (1 - t)*(1 - t)*lp.pt0.x + 2 * (1 - t)*t*lp.pt1.x + t*t*lp.pt2.x;
-	point.y = (1 - t)*(1 - t)*lp.pt0.y + 2 * (1 - t)*t*lp.pt1.y + t*t*lp.pt2.y;
-	point.z = (1 - t)*(1 - t)*lp.pt0.z + 2 * (1 - t)*t*lp.pt1.z + t*t*lp.pt2.z;
+		_buildPart(index - 1);
+		_addPartLength(index - 1, lp.length - length);
+		if (m_partCounts <= m_bvhLeaves) _updateBvh(index - 1);
 
-	tangent.x = 2 * (t - 1)*lp.pt0.x + (2 - 4 * t)*lp.pt1.x + 2 * t*lp.pt2.x;
-	tangent.y = 2 * (t - 1)*lp.pt0.y + (2 - 4 * t)*lp.pt1.y + 2 * t*lp.pt2.y;
-	tangent.z = 2 * (t - 1)*lp.pt0.z + (2 - 4 * t)*lp.pt1.z + 2 * t*lp.pt2.z;
-	_normalize(tangent);
+		if (m_invertTable) {
+			_refitInvertTable(index - 1, newton);
+		}
+	}
+
+	_setPartLength(index);
+
+	//a full tree doubles, so the rebuild is amortized O(1) as well
+	if (m_partCounts > m_bvhLeaves) {
+		_buildBvh(1);
+	}
+	else {
+		_updateBvh(index);
+	}
+	if (m_invertTable) {
+		_refitInvertTable(index, false);
+	}
+
+	m_totalLength = _getStartLength(m_partCounts);
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+T BlineT<T>::checkLength(void) const
+{
+	Real maxError = (Real)0.0;
+	for (size_t i = 0; i < m_partCounts; i++) {
+		const LinePart& lp = m_parts[i];
+		if (lp.length <= (Real)0.0) continue;
+
+		Real error = fabs(_getCompositeLength(lp, (Real)1.0, 32) - lp.length) / lp.length;
+		if (error > maxError) maxError = error;
+	}
+	return maxError;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::getPartTypeCounts(size_t& straight, size_t& nearStraight, size_t& general) const
+{
+	straight = nearStraight = general = 0;
+	for (size_t i = 0; i < m_partCounts; i++) {
+		switch (m_parts[i].type) {
+		case PT_STRAIGHT: straight++; break;
+		case PT_NEAR_STRAIGHT: nearStraight++; break;
+		default: general++; break;
+		}
+	}
+}
 
-	return;
-}
\ No newline at end of file
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::getBounder(Point& min, Point& max) const
+{
+	//the root of the bvh
+	if (m_partCounts == 0) {
+		min.x = min.y = min.z = std::numeric_limits<Real>::max();
+		max.x = max.y = max.z = std::numeric_limits<Real>::lowest();
+		return;
+	}
+	min = m_bvh[1].min;
+	max = m_bvh[1].max;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::getPartBounder(size_t index, Point& min, Point& max) const
+{
+	assert(index < m_partCounts);
+
+	min = m_bvh[m_bvhLeaves + index].min;
+	max = m_bvh[m_bvhLeaves + index].max;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+T BlineT<T>::_getInvertLength(const LinePart& lp, Real t, Real length, unsigned int maxIterations, InvertStats* stats)
+{
+	const Real tolerance = BlineTraits<Real>::invertTolerance();
+
+	//length is increasing in t, so every evaluation shrinks a bracket around the root.
+	//a Newton step leaving the bracket is retried as Halley, then as bisection
+	Real lo = (Real)0.0, hi = (Real)1.0;
+	unsigned int iterations = 0, fallbacks = 0;
+	bool converged = false;
+
+	while (iterations < maxIterations) {
+		iterations++;
+
+		Real f = _getlength(lp, t) - length;
+		if (f != f) break;	//degenerated part
+		if (f == (Real)0.0) {
+			converged = true;
+			break;
+		}
+		if (f < (Real)0.0) lo = t; else hi = t;
+
+		Real speed = _getSpeed(lp, t);
+		Real t2 = t - f / speed;
+
+		if (!(t2 > lo && t2 < hi) && !(fabs(t2 - t) < tolerance)) {
+			fallbacks++;
+
+			Real dspeed = (2 * lp.A*t + lp.B) / (2 * speed);
+			t2 = t - 2 * f*speed / (2 * speed*speed - f*dspeed);
+			if (!(t2 > lo && t2 < hi)) t2 = (lo + hi) / 2;
+		}
+
+		Real step = fabs(t2 - t);
+		t = t2;
+		if (step < tolerance || hi - lo < tolerance) {
+			converged = true;
+			break;
+		}
+	}
+
+	if (stats) {
+		stats->iterations = iterations;
+		stats->fallbacks = fallbacks;
+		stats->converged = converged;
+	}
+	return t;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+T BlineT<T>::_getSpeed(const LinePart& lp, Real t)
+{
+	return sqrt(lp.A*t*t + lp.B*t + lp.C);
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::setFastInvert(bool enable, Real maxError, bool polish)
+{
+	m_fastInvert = enable;
+	m_fastInvertError = maxError;
+	m_fastInvertPolish = polish;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::getFastInvertInfo(size_t& bytes, Real& maxError, size_t& newtonParts) const
+{
+	bytes = m_invertTable ? (m_invertTableSize*sizeof(Real) + m_partCounts*2*sizeof(size_t)) : 0;
+	maxError = m_invertTableError;
+	newtonParts = m_invertNewtonParts;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_buildInvertTable(size_t threads)
+{
+	//every thread fits a contiguous range of parts, the first thread right into the kept
+	//table and the others into their own, which are then joined in order
+	std::vector<std::vector<Real> > tables(threads - 1);
+	size_t newtonParts[MAX_THREADS];
+	Real errors[MAX_THREADS];
+	size_t firstPart[MAX_THREADS + 1];
+	firstPart[threads] = m_partCounts;
+
+	m_invertTableSize = 0;
+	_parallelFor(threads, m_partCounts, [&](size_t thread, size_t begin, size_t end) {
+		Real knots[64 * 2 + 2];
+		firstPart[thread] = begin;
+		newtonParts[thread] = 0;
+		errors[thread] = (Real)0.0;
+
+		for (size_t i = begin; i < end; i++) {
+			LinePart& lp = m_parts[i];
+			lp.invertOffset = (thread == 0) ? m_invertTableSize : tables[thread - 1].size();
+			lp.invertCounts = 0;
+			if (lp.type == PT_STRAIGHT) continue;
+
+			Real error;
+			size_t counts = _fitInvertTable(lp, knots, error);
+			if (counts == 0) {
+				//t(s) too steep to tabulate (near cusp), keep Newton for this part
+				newtonParts[thread]++;
+				continue;
+			}
+
+			lp.invertCounts = counts;
+			size_t size = (counts + 1) * 2;
+			if (thread == 0) {
+				_reserveInvertTable(m_invertTableSize + size);
+				memcpy(m_invertTable + m_invertTableSize, knots, size*sizeof(Real));
+				m_invertTableSize += size;
+			}
+			else {
+				tables[thread - 1].insert(tables[thread - 1].end(), knots, knots + size);
+			}
+
+			if (error > errors[thread]) errors[thread] = error;
+		}
+	});
+
+	size_t tableSize = m_invertTableSize;
+	m_invertTableError = errors[0];
+	m_invertNewtonParts = newtonParts[0];
+	for (size_t i = 1; i < threads; i++) {
+		tableSize += tables[i - 1].size();
+		m_invertNewtonParts += newtonParts[i];
+		if (errors[i] > m_invertTableError) m_invertTableError = errors[i];
+	}
+
+	//never null once built, m_invertTable tells setKey and appendKey to refit
+	_reserveInvertTable((tableSize > 0) ? tableSize : 1);
+
+	for (size_t i = 1; i < threads; i++) {
+		std::vector<Real>& table = tables[i - 1];
+		if (!table.empty()) {
+			memcpy(m_invertTable + m_invertTableSize, &table[0], table.size()*sizeof(Real));
+		}
+		for (size_t p = firstPart[i]; p < firstPart[i + 1]; p++) {
+			m_parts[p].invertOffset += m_invertTableSize;
+		}
+		m_invertTableSize += table.size();
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_reserveInvertTable(size_t size)
+{
+	if (m_invertTable && size <= m_invertTableCapacity) return;
+
+	size_t capacity = (m_invertTableCapacity * 2 > size) ? m_invertTableCapacity * 2 : size;
+
+	Real* table = _allocate<Real>(capacity);
+	if (m_invertTableSize > 0) memcpy(table, m_invertTable, m_invertTableSize*sizeof(Real));
+	_deallocate(m_invertTable, m_invertTableCapacity);
+	m_invertTable = table;
+	m_invertTableCapacity = capacity;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_refitInvertTable(size_t index, bool newton)
+{
+	LinePart& lp = m_parts[index];
+
+	//refit in place while the knots fit the slot of the part. the slot at the tail of the
+	//table may grow, any other slot too small moves to the tail. the slots left behind are
+	//dropped when the table would have to grow, so edits keep it within twice its use
+	size_t slotSize = (lp.invertCounts > 0) ? (lp.invertCounts + 1) * 2 : 0;
+	bool tail = (lp.invertOffset + slotSize == m_invertTableSize);
+
+	if (newton) m_invertNewtonParts--;
+	lp.invertCounts = 0;
+	if (lp.type == PT_STRAIGHT) return;
+
+	Real knots[64 * 2 + 2];
+	Real error;
+	size_t counts = _fitInvertTable(lp, knots, error);
+	size_t size = (counts + 1) * 2;
+
+	if (counts == 0) {
+		m_invertNewtonParts++;
+		return;
+	}
+
+	if (!tail && size > slotSize) {
+		if (m_invertTableSize + size > m_invertTableCapacity) _compactInvertTable(size);
+		lp.invertOffset = m_invertTableSize;
+		tail = true;
+	}
+	if (tail) {
+		_reserveInvertTable(lp.invertOffset + size);
+		m_invertTableSize = lp.invertOffset + size;
+	}
+
+	memcpy(m_invertTable + lp.invertOffset, knots, size*sizeof(Real));
+	lp.invertCounts = counts;
+	if (error > m_invertTableError) m_invertTableError = error;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_compactInvertTable(size_t extra)
+{
+	//slots back to back in part order, parts without knots take none. O(n), but only run
+	//once moved slots have filled the table, which then has room for as much again
+	size_t size = 0;
+	for (size_t i = 0; i < m_partCounts; i++) {
+		if (m_parts[i].invertCounts > 0) size += (m_parts[i].invertCounts + 1) * 2;
+	}
+
+	size_t capacity = (size + extra) * 2;
+	Real* table = _allocate<Real>(capacity);
+
+	size_t offset = 0;
+	for (size_t i = 0; i < m_partCounts; i++) {
+		LinePart& lp = m_parts[i];
+		size_t slotSize = (lp.invertCounts > 0) ? (lp.invertCounts + 1) * 2 : 0;
+		if (slotSize > 0) memcpy(table + offset, m_invertTable + lp.invertOffset, slotSize*sizeof(Real));
+		lp.invertOffset = offset;
+		offset += slotSize;
+	}
+
+	_deallocate(m_invertTable, m_invertTableCapacity);
+	m_invertTable = table;
+	m_invertTableCapacity = capacity;
+	m_invertTableSize = offset;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+size_t BlineT<T>::_fitInvertTable(const LinePart& lp, Real* knots, Real& error) const
+{
+	//knots holds up to 65 (t, dt/ds) pairs, returns the counts of intervals or 0 when the
+	//error bound can not be met
+	const size_t minCounts = 4;
+	const size_t maxCounts = 64;
+
+	//double the knot counts until the error at the quarters of every interval is small enough
+	size_t counts = minCounts;
+	do {
+		for (size_t k = 0; k <= counts; k++) {
+			Real s = (Real)k / (Real)counts;
+			Real t = (k == 0) ? (Real)0.0 : ((k == counts) ? (Real)1.0 : _getInvertLength(lp, s, s*lp.length, m_maxIterations, nullptr));
+			knots[k * 2] = t;
+		}
+
+		//dt/ds scaled to one interval, clamped (Fritsch-Carlson) to keep the cubic monotone
+		for (size_t k = 0; k <= counts; k++) {
+			Real t = knots[k * 2];
+			Real secant = (k < counts) ? (knots[k * 2 + 2] - t) : (t - knots[k * 2 - 2]);
+			if (k > 0 && k < counts && t - knots[k * 2 - 2] < secant) secant = t - knots[k * 2 - 2];
+
+			Real speed = _getSpeed(lp, t);
+			Real d = (speed > (Real)0.0) ? lp.length / (speed*(Real)counts) : 3 * secant;
+			knots[k * 2 + 1] = (d < 3 * secant) ? d : 3 * secant;
+		}
+
+		error = (Real)0.0;
+		for (size_t k = 0; k < counts * 2; k++) {
+			Real s = ((Real)k + (Real)0.5) / (Real)(counts * 2);
+			Real exact = _getInvertLength(lp, s, s*lp.length, m_maxIterations, nullptr);
+			Real e = fabs(_getTableInvert(knots, counts, s) - exact);
+			if (e > error) error = e;
+		}
+
+		if (error <= m_fastInvertError || counts >= maxCounts) break;
+		counts *= 2;
+	} while (true);
+
+	return (error > m_fastInvertError) ? 0 : counts;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+T BlineT<T>::_getTableInvert(const Real* knots, size_t counts, Real percent)
+{
+	Real x = percent*(Real)counts;
+	size_t k = (x > (Real)0.0) ? (size_t)x : 0;
+	if (k >= counts) k = counts - 1;
+
+	//cubic hermite between knot k and k+1
+	const Real* p = knots + k * 2;
+	Real h = x - (Real)k;
+	Real h2 = h*h;
+	Real h3 = h2*h;
+
+	return (2 * h3 - 3 * h2 + 1)*p[0] + (h3 - 2 * h2 + h)*p[1] + (3 * h2 - 2 * h3)*p[2] + (h3 - h2)*p[3];
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+T BlineT<T>::_getPartParam(const LinePart& lp, Real percent, InvertStats* stats) const
+{
+	Real length = percent*lp.length;
+	Real t;
+	if (lp.type == PT_STRAIGHT) {
+		t = _getStraightInvert(lp, length);
+
+		if (stats) {
+			stats->iterations = stats->fallbacks = 0;
+			stats->converged = true;
+		}
+	}
+	else if (m_invertTable && lp.invertCounts > 0) {
+		t = _getTableInvert(m_invertTable + lp.invertOffset, lp.invertCounts, percent);
+		if (m_fastInvertPolish) {
+			t -= (_getlength(lp, t) - length) / _getSpeed(lp, t);
+		}
+
+		if (stats) {
+			stats->iterations = m_fastInvertPolish ? 1 : 0;
+			stats->fallbacks = 0;
+			stats->converged = true;
+		}
+	}
+	else {
+		t = _getInvertLength(lp, percent, length, m_maxIterations, stats);
+	}
+
+	return t;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+T BlineT<T>::_getWarmParam(const LinePart& lp, Real param, Real lastLocal, Real local) const
+{
+	if (lp.type == PT_STRAIGHT || (m_invertTable && lp.invertCounts > 0) || lp.length <= (Real)0.0) {
+		return _getPartParam(lp, (lp.length > (Real)0.0) ? local / lp.length : (Real)0.0, nullptr);
+	}
+
+	//second order guess from the parameter before, ds/du is the speed
+	Real speed = _getSpeed(lp, param);
+	Real guess = local / lp.length;
+	if (speed > (Real)0.0) {
+		Real ds = local - lastLocal;
+		Real dspeed = (2 * lp.A*param + lp.B) / (2 * speed);
+		guess = param + ds / speed - dspeed*ds*ds / (2 * speed*speed*speed);
+	}
+	if (!(guess > (Real)0.0)) guess = (Real)0.0;
+	if (guess > (Real)1.0) guess = (Real)1.0;
+
+	//then one Newton step, leaving a parameter error of about delta^2 |speed'| / 2speed,
+	//only one above the inversion tolerance goes through the bracketed solve
+	speed = _getSpeed(lp, guess);
+	Real delta = (speed > (Real)0.0) ? (_getlength(lp, guess) - local) / speed : (Real)1.0;
+	Real dspeed = (speed > (Real)0.0) ? (2 * lp.A*guess + lp.B) / (2 * speed) : (Real)0.0;
+	Real t = guess - delta;
+	if (!(t >= (Real)0.0 && t <= (Real)1.0) ||
+		fabs(dspeed)*delta*delta >= 2 * BlineTraits<Real>::invertTolerance()*speed) {
+		t = _getInvertLength(lp, guess, local, m_maxIterations, nullptr);
+	}
+	return t;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_getPartPoint(size_t partIndex, Real percent, Point& point, Point& tangent, InvertStats* stats) const
+{
+	Real t = _getPartParam(m_parts[partIndex], percent, stats);
+	_evaluate(m_partControls[partIndex], t, point, tangent);
+	_normalize(tangent);
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_evaluate(const PartControl& pc, Real u, Point& point, Point& tangent)
+{
+	BlineSimd::bezier(&pc.pt0.x, u, &point.x, &tangent.x);
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_getHeadPoint(Point& point, Point& tangent) const
+{
+	point = m_keyPoints[0];
+	tangent.x = -2 * point.x + 2 * m_keyPoints[1].x;
+	tangent.y = -2 * point.y + 2 * m_keyPoints[1].y;
+	tangent.z = -2 * point.z + 2 * m_keyPoints[1].z;
+	_normalize(tangent);
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_getTailPoint(Point& point, Point& tangent) const
+{
+	point = m_keyPoints[m_keyCounts - 1];
+	tangent.x = -2 * m_keyPoints[m_keyCounts - 2].x + 2 * point.x;
+	tangent.y = -2 * m_keyPoints[m_keyCounts - 2].y + 2 * point.y;
+	tangent.z = -2 * m_keyPoints[m_keyCounts - 2].z + 2 * point.z;
+	_normalize(tangent);
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_getShortPoint(Real t, Point& point, Point& tangent) const
+{
+	point.x = point.y = point.z = (Real)0.0;
+	tangent = point;
+	if (m_keyCounts == 0) return;
+
+	point = m_keyPoints[0];
+	if (m_keyCounts == 1) return;
+
+	//the segment is its own arc length parameter
+	const Point& end = m_keyPoints[1];
+	tangent.x = end.x - point.x;
+	tangent.y = end.y - point.y;
+	tangent.z = end.z - point.z;
+	point.x += t*tangent.x;
+	point.y += t*tangent.y;
+	point.z += t*tangent.z;
+	_normalize(tangent);
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+size_t BlineT<T>::_findPart(Real length, Real& startLength) const
+{
+	//fenwick descent, the first part whose end is not before length. the tree is padded to a
+	//power of two so the descent never checks bounds, the sum of the skipped nodes is the start.
+	//length must not pass the total length, with a power of two part counts there is no
+	//infinite padding and the descent would leave the tree
+	size_t pos = 0;
+	Real sum = (Real)0.0;
+
+	for (size_t mask = m_lengthTreeSize; mask > 0; mask >>= 1) {
+		Real next = sum + m_lengthTree[pos + mask - 1];
+		bool skip = next < length;
+		pos += skip ? mask : 0;
+		sum = skip ? next : sum;
+	}
+
+	startLength = sum;
+	return pos;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+T BlineT<T>::_getStartLength(size_t index) const
+{
+	//nodes are added in the order of _findPart, so both give the same bits for a part start
+	size_t pos = 0;
+	Real sum = (Real)0.0;
+
+	for (size_t mask = m_lengthTreeSize; mask > 0; mask >>= 1) {
+		if (pos + mask <= index) {
+			sum += m_lengthTree[pos + mask - 1];
+			pos += mask;
+		}
+	}
+	return sum;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+T BlineT<T>::getPartLength(size_t index) const
+{
+	assert(index < m_partCounts);
+	return m_parts[index].length;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+T BlineT<T>::getLength(Real param) const
+{
+	if (!(param > (Real)0.0) || m_partCounts == 0) return (Real)0.0;
+	if (param >= (Real)m_partCounts) return m_totalLength;
+
+	size_t partIndex = (size_t)param;
+	Real u = param - (Real)partIndex;
+	Real length = (u > (Real)0.0) ? _getlength(m_parts[partIndex], u) : (Real)0.0;
+	return _getStartLength(partIndex) + length;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+size_t BlineT<T>::getPartAt(Real length, Real& param) const
+{
+	param = (Real)0.0;
+	if (!(length > (Real)0.0) || m_partCounts == 0) return 0;
+	if (length >= m_totalLength) {
+		param = (Real)1.0;
+		return m_partCounts - 1;
+	}
+
+	Real startLength;
+	size_t partIndex = _findPart(length, startLength);
+	if (partIndex >= m_partCounts) {
+		param = (Real)1.0;
+		return m_partCounts - 1;
+	}
+
+	const LinePart& lp = m_parts[partIndex];
+	Real percent = (lp.length > (Real)0.0) ? (length - startLength) / lp.length : (Real)0.0;
+	if (percent > (Real)1.0) percent = (Real)1.0;
+	param = _getPartParam(lp, percent, nullptr);
+	return partIndex;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+T BlineT<T>::getParam(Real length) const
+{
+	Real param;
+	size_t partIndex = getPartAt(length, param);
+	return (Real)partIndex + param;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::getLengths(const Real* params, size_t counts, Real* lengths) const
+{
+	//the start of the last part looked up is kept
+	size_t partIndex = m_partCounts;
+	Real partStart = (Real)0.0;
+
+	for (size_t i = 0; i < counts; i++) {
+		Real param = params[i];
+		if (!(param > (Real)0.0) || m_partCounts == 0) {
+			lengths[i] = (Real)0.0;
+			continue;
+		}
+		if (param >= (Real)m_partCounts) {
+			lengths[i] = m_totalLength;
+			continue;
+		}
+
+		size_t index = (size_t)param;
+		if (index != partIndex) {
+			partIndex = index;
+			partStart = _getStartLength(index);
+		}
+
+		Real u = param - (Real)index;
+		lengths[i] = partStart + ((u > (Real)0.0) ? _getlength(m_parts[index], u) : (Real)0.0);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::getParams(const Real* lengths, size_t counts, Real* params) const
+{
+	size_t partIndex = m_partCounts;
+	Real partStart = (Real)0.0, partEnd = (Real)0.0;
+	Real u = (Real)0.0, lastLocal = (Real)0.0;
+
+	for (size_t i = 0; i < counts; i++) {
+		Real length = lengths[i];
+		if (!(length > (Real)0.0) || m_partCounts == 0) {
+			params[i] = (Real)0.0;
+			continue;
+		}
+		if (length >= m_totalLength) {
+			params[i] = (Real)m_partCounts;
+			continue;
+		}
+
+		if (partIndex >= m_partCounts || !(length > partStart && length <= partEnd)) {
+			partIndex = _findPart(length, partStart);
+			if (partIndex >= m_partCounts) {
+				params[i] = (Real)m_partCounts;
+				continue;
+			}
+			partEnd = _getStartLength(partIndex + 1);
+
+			const LinePart& lp = m_parts[partIndex];
+			lastLocal = length - partStart;
+			Real percent = (lp.length > (Real)0.0) ? lastLocal / lp.length : (Real)0.0;
+			u = _getPartParam(lp, (percent < (Real)1.0) ? percent : (Real)1.0, nullptr);
+		}
+		else {
+			Real local = length - partStart;
+			u = _getWarmParam(m_parts[partIndex], u, lastLocal, local);
+			lastLocal = local;
+		}
+
+		params[i] = (Real)partIndex + u;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::getPoint(Real t, Point& point, Point& tangent, InvertStats* stats) const
+{
+	assert(t >= (Real)0.0 && t <= (Real)1.0);
+
+	if (stats) {
+		stats->iterations = stats->fallbacks = 0;
+		stats->converged = true;
+	}
+
+	if (m_partCounts == 0) {
+		_getShortPoint(t, point, tangent);
+		return;
+	}
+
+	if (t <= (Real)0.0) {
+		_getHeadPoint(point, tangent);
+		return;
+	}
+
+	Real length = t*m_totalLength;
+	Real start_length;
+	size_t partIndex = _findPart(length, start_length);
+
+	if (partIndex >= m_partCounts) {
+		_getTailPoint(point, tangent);
+		return;
+	}
+
+	const LinePart& lp = m_parts[partIndex];
+
+	Real percent = (lp.length > (Real)0.0) ? (length - start_length) / lp.length : (Real)0.0;
+	_getPartPoint(partIndex, percent, point, tangent, stats);
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::getPoints(const Real* t, size_t counts, const PointArray& points, const PointArray& tangents) const
+{
+	assert(sizeof(PartControl) == 9 * sizeof(Real));
+
+	if (m_partCounts == 0) {
+		for (size_t i = 0; i < counts; i++) {
+			Point point, tangent;
+			_getShortPoint(t[i], point, tangent);
+			points.x[i] = point.x; points.y[i] = point.y; points.z[i] = point.z;
+			tangents.x[i] = tangent.x; tangents.y[i] = tangent.y; tangents.z[i] = tangent.z;
+		}
+		return;
+	}
+
+	//parts and curve parameters are found one chunk at a time, the bezier evaluation of
+	//the chunk then runs in the simd kernel
+	const size_t chunkCounts = 256;
+	size_t part[chunkCounts];
+	Real param[chunkCounts];
+
+	//the part found for the previous sample is checked first, so sorted (or nearly sorted)
+	//input does not touch the search index at all
+	size_t partIndex = m_partCounts;
+	Real partStart = (Real)0.0, partEnd = (Real)0.0;
+
+	for (size_t base = 0; base < counts; base += chunkCounts) {
+		size_t n = (counts - base < chunkCounts) ? counts - base : chunkCounts;
+
+		for (size_t i = 0; i < n; i++) {
+			Real ti = t[base + i];
+			assert(ti >= (Real)0.0 && ti <= (Real)1.0);
+
+			//head and tail are the ends of the first and last part
+			if (ti <= (Real)0.0) {
+				part[i] = 0;
+				param[i] = (Real)0.0;
+				continue;
+			}
+
+			Real length = ti*m_totalLength;
+
+			if (partIndex >= m_partCounts || partEnd < length || (partIndex > 0 && partStart >= length)) {
+				Real nextEnd = (partIndex + 1 < m_partCounts && partEnd < length) ? _getStartLength(partIndex + 2) : (Real)0.0;
+				if (partIndex + 1 < m_partCounts && partEnd < length && nextEnd >= length) {
+					partIndex++;
+					partStart = partEnd;
+					partEnd = nextEnd;
+				}
+				else {
+					partIndex = _findPart(length, partStart);
+					partEnd = (partIndex < m_partCounts) ? _getStartLength(partIndex + 1) : partStart;
+				}
+			}
+
+			if (partIndex >= m_partCounts) {
+				part[i] = m_partCounts - 1;
+				param[i] = (Real)1.0;
+			}
+			else {
+				const LinePart& lp = m_parts[partIndex];
+				Real percent = (lp.length > (Real)0.0) ? (length - partStart) / lp.length : (Real)0.0;
+
+				part[i] = partIndex;
+				param[i] = _getPartParam(lp, percent, nullptr);
+			}
+		}
+
+		BlineSimd::evaluate(param, part, n, &(m_partControls[0].pt0.x), 9,
+			points.x + base, points.y + base, points.z + base, tangents.x + base, tangents.y + base, tangents.z + base);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+int BlineT<T>::_solveCubic(Real a, Real b, Real c, Real d, Real roots[3])
+{
+	//real roots of a*x^3 + b*x^2 + c*x + d, a leading coefficient lost in rounding drops
+	//the degree
+	const Real epsilon = std::numeric_limits<Real>::epsilon() * 16;
+	const Real pi = (Real)3.14159265358979323846;
+
+	Real scale = fabs(a) + fabs(b) + fabs(c) + fabs(d);
+	if (scale == (Real)0.0) return 0;
+
+	int counts = 0;
+	if (fabs(a) <= epsilon*scale) {
+		if (fabs(b) <= epsilon*scale) {
+			if (c == (Real)0.0) return 0;
+			roots[0] = -d / c;
+			return 1;
+		}
+
+		Real disc = c*c - 4 * b*d;
+		if (disc < (Real)0.0) return 0;
+
+		//the form without cancellation
+		Real q = (c < (Real)0.0) ? (-c + sqrt(disc)) / 2 : (-c - sqrt(disc)) / 2;
+		roots[counts++] = q / b;
+		if (q != (Real)0.0) roots[counts++] = d / q;
+		return counts;
+	}
+
+	//depressed cubic y^3 + p*y + q with x = y - A/3
+	Real A = b / a, B = c / a, C = d / a;
+	Real p = B - A*A / 3;
+	Real q = 2 * A*A*A / 27 - A*B / 3 + C;
+	Real disc = q*q / 4 + p*p*p / 27;
+
+	if (disc > (Real)0.0) {
+		Real s = sqrt(disc);
+		roots[counts++] = cbrt(-q / 2 + s) + cbrt(-q / 2 - s) - A / 3;
+	}
+	else if (p == (Real)0.0) {
+		roots[counts++] = -A / 3;
+	}
+	else {
+		//three real roots, trigonometric form
+		Real r = 2 * sqrt(-p / 3);
+		Real cosine = 3 * q / (p*r);
+		if (cosine > (Real)1.0) cosine = (Real)1.0;
+		if (cosine < (Real)-1.0) cosine = (Real)-1.0;
+		Real phi = acos(cosine) / 3;
+		for (int k = 0; k < 3; k++) {
+			roots[counts++] = r*cos(phi - 2 * pi*k / 3) - A / 3;
+		}
+	}
+
+	//one Newton step each, the closed forms lose digits near double roots
+	for (int i = 0; i < counts; i++) {
+		Real x = roots[i];
+		Real f = ((a*x + b)*x + c)*x + d;
+		Real df = (3 * a*x + 2 * b)*x + c;
+		if (df != (Real)0.0) roots[i] = x - f / df;
+	}
+	return counts;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+T BlineT<T>::_getPartDistance(const PartControl& pc, const Point& point, Real& t)
+{
+	//squared distance of B(t) = a*t^2 + b*t + pt0 to point, its derivative
+	//(a*t^2 + b*t + c).(2a*t + b) is a cubic in t
+	Point a, b, c;
+	a.x = pc.pt0.x - 2 * pc.pt1.x + pc.pt2.x;
+	a.y = pc.pt0.y - 2 * pc.pt1.y + pc.pt2.y;
+	a.z = pc.pt0.z - 2 * pc.pt1.z + pc.pt2.z;
+	b.x = 2 * (pc.pt1.x - pc.pt0.x);
+	b.y = 2 * (pc.pt1.y - pc.pt0.y);
+	b.z = 2 * (pc.pt1.z - pc.pt0.z);
+	c.x = pc.pt0.x - point.x;
+	c.y = pc.pt0.y - point.y;
+	c.z = pc.pt0.z - point.z;
+
+	Real aa = a.x*a.x + a.y*a.y + a.z*a.z;
+	Real ab = a.x*b.x + a.y*b.y + a.z*b.z;
+	Real ac = a.x*c.x + a.y*c.y + a.z*c.z;
+	Real bb = b.x*b.x + b.y*b.y + b.z*b.z;
+	Real bc = b.x*c.x + b.y*c.y + b.z*c.z;
+
+	Real candidates[5] = { (Real)0.0, (Real)1.0 };
+	int counts = 2 + _solveCubic(2 * aa, 3 * ab, bb + 2 * ac, bc, candidates + 2);
+
+	Real best = std::numeric_limits<Real>::infinity();
+	for (int i = 0; i < counts; i++) {
+		Real u = candidates[i];
+		if (!(u > (Real)0.0)) u = (Real)0.0;
+		if (u > (Real)1.0) u = (Real)1.0;
+
+		Real x = (a.x*u + b.x)*u + c.x;
+		Real y = (a.y*u + b.y)*u + c.y;
+		Real z = (a.z*u + b.z)*u + c.z;
+		Real distance = x*x + y*y + z*z;
+		if (distance < best) {
+			best = distance;
+			t = u;
+		}
+	}
+	return best;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+T BlineT<T>::_getBoxDistance(const Box& box, const Point& point)
+{
+	//squared, infinite for an empty box
+	Real x = (box.min.x - point.x > point.x - box.max.x) ? box.min.x - point.x : point.x - box.max.x;
+	Real y = (box.min.y - point.y > point.y - box.max.y) ? box.min.y - point.y : point.y - box.max.y;
+	Real z = (box.min.z - point.z > point.z - box.max.z) ? box.min.z - point.z : point.z - box.max.z;
+	if (x < (Real)0.0) x = (Real)0.0;
+	if (y < (Real)0.0) y = (Real)0.0;
+	if (z < (Real)0.0) z = (Real)0.0;
+	return x*x + y*y + z*z;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+bool BlineT<T>::project(const Point& point, Projection& result) const
+{
+	if (m_partCounts == 0) return false;
+
+	//depth first, the nearer child first, boxes farther than the best part so far are skipped
+	size_t stack[sizeof(size_t) * 8 + 1];
+	size_t top = 0;
+	stack[top++] = 1;
+
+	Real best = std::numeric_limits<Real>::infinity();
+	size_t bestPart = 0;
+	Real bestParam = (Real)0.0;
+
+	while (top > 0) {
+		size_t node = stack[--top];
+
+		if (node >= m_bvhLeaves) {
+			//the best may have improved since the leaf was pushed
+			if (_getBoxDistance(m_bvh[node], point) >= best) continue;
+
+			size_t part = node - m_bvhLeaves;
+			Real u;
+			Real distance = _getPartDistance(m_partControls[part], point, u);
+			if (distance < best) {
+				best = distance;
+				bestPart = part;
+				bestParam = u;
+			}
+			continue;
+		}
+
+		Real nearDistance = _getBoxDistance(m_bvh[node * 2], point);
+		Real farDistance = _getBoxDistance(m_bvh[node * 2 + 1], point);
+		size_t nearNode = node * 2, farNode = node * 2 + 1;
+		if (farDistance < nearDistance) {
+			std::swap(nearDistance, farDistance);
+			std::swap(nearNode, farNode);
+		}
+
+		if (farDistance < best) stack[top++] = farNode;
+		if (nearDistance < best) stack[top++] = nearNode;
+	}
+
+	Real u = bestParam;
+	Point tangent;
+	_evaluate(m_partControls[bestPart], u, result.point, tangent);
+	result.distance = sqrt(best);
+
+	const LinePart& lp = m_parts[bestPart];
+	Real length = (u >= (Real)1.0) ? lp.length : _getlength(lp, u);
+	result.length = _getStartLength(bestPart) + ((u > (Real)0.0) ? length : (Real)0.0);
+	result.t = (m_totalLength > (Real)0.0) ? result.length / m_totalLength : (Real)0.0;
+	if (result.t > (Real)1.0) result.t = (Real)1.0;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+size_t BlineT<T>::tessellate(Real tolerance, const PointArray& points, size_t capacity, Real* t) const
+{
+	assert(tolerance > (Real)0.0);
+	if (m_partCounts == 0) return 0;
+
+	size_t counts = 0;
+	for (size_t i = 0; i < m_partCounts; i++) {
+		const PartControl& pc = m_partControls[i];
+
+		//B(u) = p0 + bu + au^2, a step h strays at most |a|h^2/4 from its chord
+		Point a, b;
+		a.x = pc.pt0.x - 2 * pc.pt1.x + pc.pt2.x;
+		a.y = pc.pt0.y - 2 * pc.pt1.y + pc.pt2.y;
+		a.z = pc.pt0.z - 2 * pc.pt1.z + pc.pt2.z;
+		b.x = 2 * (pc.pt1.x - pc.pt0.x);
+		b.y = 2 * (pc.pt1.y - pc.pt0.y);
+		b.z = 2 * (pc.pt1.z - pc.pt0.z);
+
+		size_t steps = (size_t)ceil(sqrt(sqrt(a.x*a.x + a.y*a.y + a.z*a.z) / (4 * tolerance)));
+		if (steps == 0) steps = 1;
+
+		//the end of a part is the beginning of the next, only the last part writes it
+		size_t last = (i == m_partCounts - 1) ? steps + 1 : steps;
+		if (counts >= capacity) {
+			counts += last;
+			continue;
+		}
+
+		const LinePart& lp = m_parts[i];
+		Real startLength = (t != nullptr) ? _getStartLength(i) : (Real)0.0;
+
+		for (size_t k = 0; k < last; k++, counts++) {
+			if (counts >= capacity) {
+				counts += last - k;
+				break;
+			}
+
+			if (k == steps) {
+				points.x[counts] = pc.pt2.x;
+				points.y[counts] = pc.pt2.y;
+				points.z[counts] = pc.pt2.z;
+				if (t) t[counts] = (Real)1.0;
+				continue;
+			}
+
+			Real u = (Real)k / (Real)steps;
+			points.x[counts] = pc.pt0.x + (b.x + a.x*u)*u;
+			points.y[counts] = pc.pt0.y + (b.y + a.y*u)*u;
+			points.z[counts] = pc.pt0.z + (b.z + a.z*u)*u;
+
+			if (t) {
+				Real length = startLength + ((k > 0) ? _getlength(lp, u) : (Real)0.0);
+				t[counts] = (m_totalLength > (Real)0.0) ? length / m_totalLength : (Real)0.0;
+				if (t[counts] > (Real)1.0) t[counts] = (Real)1.0;
+			}
+		}
+	}
+	return counts;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+size_t BlineT<T>::getFrames(Real step, const Point& up, const PointArray& points, const PointArray& tangents, const PointArray& normals, size_t capacity) const
+{
+	FrameCursor cursor;
+	beginFrames(step, up, cursor);
+	nextFrames(cursor, points, tangents, normals, capacity);
+	return cursor.counts;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::beginFrames(Real step, const Point& up, FrameCursor& cursor) const
+{
+	assert(step > (Real)0.0);
+
+	//nextFrames takes every field over, set or not
+	memset(&cursor, 0, sizeof(cursor));
+	cursor.step = step;
+	cursor.up = up;
+	if (m_partCounts == 0) return;
+
+	cursor.counts = (size_t)ceil(m_totalLength / step) + 1;
+	if (cursor.counts < 2) cursor.counts = 2;
+	cursor.partEnd = _getStartLength(1);
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+size_t BlineT<T>::nextFrames(FrameCursor& cursor, const PointArray& points, const PointArray& tangents, const PointArray& normals, size_t capacity) const
+{
+	if (capacity > cursor.counts - cursor.index) capacity = cursor.counts - cursor.index;
+
+	size_t partIndex = cursor.part;
+	Real partStart = cursor.partStart;
+	Real partEnd = cursor.partEnd;
+	Real u = cursor.param, lastLength = cursor.length;
+	Point lastPoint = cursor.point, lastTangent = cursor.tangent, normal = cursor.normal;
+
+	for (size_t i = 0; i < capacity; i++) {
+		size_t k = cursor.index + i;
+		Real length = (k + 1 < cursor.counts) ? (Real)k * cursor.step : m_totalLength;
+
+		//parts are only ever walked forward
+		while (length > partEnd && partIndex + 1 < m_partCounts) {
+			partIndex++;
+			partStart = partEnd;
+			partEnd = _getStartLength(partIndex + 1);
+			u = (Real)0.0;
+			lastLength = partStart;
+		}
+
+		const LinePart& lp = m_parts[partIndex];
+		Real local = length - partStart;
+		if (local < (Real)0.0) local = (Real)0.0;
+		if (local > lp.length) local = lp.length;
+
+		u = _getWarmParam(lp, u, lastLength - partStart, local);
+		lastLength = length;
+
+		Point point, tangent;
+		_evaluate(m_partControls[partIndex], u, point, tangent);
+
+		//a cusp has no direction, it keeps the one before
+		Real tt = tangent.x*tangent.x + tangent.y*tangent.y + tangent.z*tangent.z;
+		if (tt > (Real)0.0) {
+			tt = sqrt(tt);
+			tangent.x /= tt; tangent.y /= tt; tangent.z /= tt;
+		}
+		else if (k > 0) {
+			tangent = lastTangent;
+		}
+
+		if (k == 0) {
+			_getFirstNormal(tangent, cursor.up, normal);
+		}
+		else {
+			//reflect the frame before in the bisector plane of the two points, then in the
+			//one which takes the reflected tangent onto the new one
+			Point v1 = { point.x - lastPoint.x, point.y - lastPoint.y, point.z - lastPoint.z };
+			Real c1 = v1.x*v1.x + v1.y*v1.y + v1.z*v1.z;
+			Point rL = normal, tL = lastTangent;
+			if (c1 > (Real)0.0) {
+				Real r = 2 * (v1.x*normal.x + v1.y*normal.y + v1.z*normal.z) / c1;
+				Real t = 2 * (v1.x*lastTangent.x + v1.y*lastTangent.y + v1.z*lastTangent.z) / c1;
+				rL.x -= r*v1.x; rL.y -= r*v1.y; rL.z -= r*v1.z;
+				tL.x -= t*v1.x; tL.y -= t*v1.y; tL.z -= t*v1.z;
+			}
+
+			Point v2 = { tangent.x - tL.x, tangent.y - tL.y, tangent.z - tL.z };
+			Real c2 = v2.x*v2.x + v2.y*v2.y + v2.z*v2.z;
+			normal = rL;
+			if (c2 > (Real)0.0) {
+				Real r = 2 * (v2.x*rL.x + v2.y*rL.y + v2.z*rL.z) / c2;
+				normal.x -= r*v2.x; normal.y -= r*v2.y; normal.z -= r*v2.z;
+			}
+		}
+
+		points.x[i] = point.x; points.y[i] = point.y; points.z[i] = point.z;
+		tangents.x[i] = tangent.x; tangents.y[i] = tangent.y; tangents.z[i] = tangent.z;
+		normals.x[i] = normal.x; normals.y[i] = normal.y; normals.z[i] = normal.z;
+
+		lastPoint = point;
+		lastTangent = tangent;
+	}
+
+	cursor.index += capacity;
+	cursor.part = partIndex;
+	cursor.partStart = partStart;
+	cursor.partEnd = partEnd;
+	cursor.param = u;
+	cursor.length = lastLength;
+	cursor.point = lastPoint;
+	cursor.tangent = lastTangent;
+	cursor.normal = normal;
+	return capacity;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::setCursor(Real length, Cursor& cursor) const
+{
+	if (!(length > (Real)0.0)) length = (Real)0.0;
+	if (length > m_totalLength) length = m_totalLength;
+
+	cursor.length = length;
+	cursor.speed = cursor.acceleration = (Real)0.0;
+
+	//a line without parts has length 0, the cursor stays at its first key
+	if (m_partCounts == 0) {
+		cursor.part = 0;
+		cursor.partStart = cursor.partEnd = cursor.param = (Real)0.0;
+		return;
+	}
+
+	Real startLength;
+	size_t partIndex = _findPart(length, startLength);
+	if (partIndex >= m_partCounts) {
+		partIndex = m_partCounts - 1;
+		startLength = _getStartLength(partIndex);
+	}
+
+	const LinePart& lp = m_parts[partIndex];
+	Real local = length - startLength;
+	if (local < (Real)0.0) local = (Real)0.0;
+	if (local > lp.length) local = lp.length;
+
+	cursor.part = partIndex;
+	cursor.partStart = startLength;
+	cursor.partEnd = startLength + lp.length;
+	cursor.param = _getPartParam(lp, (lp.length > (Real)0.0) ? local / lp.length : (Real)0.0, nullptr);
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+bool BlineT<T>::advance(Cursor& cursor, Real distance, Point& point, Point& tangent) const
+{
+	if (m_partCounts == 0) {
+		_getShortPoint((Real)0.0, point, tangent);
+		return false;
+	}
+
+	Real lastLocal = cursor.length - cursor.partStart;
+	Real length = cursor.length + distance;
+
+	bool moving = true;
+	if (!(length > (Real)0.0)) {
+		length = (Real)0.0;
+		moving = false;
+	}
+	if (length >= m_totalLength) {
+		length = m_totalLength;
+		moving = false;
+	}
+
+	//neighbours by their own lengths, no search. the first part starts at 0 exactly
+	while (length > cursor.partEnd && cursor.part + 1 < m_partCounts) {
+		cursor.part++;
+		cursor.partStart = cursor.partEnd;
+		cursor.partEnd = cursor.partStart + m_parts[cursor.part].length;
+		cursor.param = (Real)0.0;
+		lastLocal = (Real)0.0;
+	}
+	while (length < cursor.partStart && cursor.part > 0) {
+		cursor.part--;
+		cursor.partEnd = cursor.partStart;
+		cursor.partStart = (cursor.part > 0) ? cursor.partEnd - m_parts[cursor.part].length : (Real)0.0;
+		cursor.param = (Real)1.0;
+		lastLocal = m_parts[cursor.part].length;
+	}
+
+	const LinePart& lp = m_parts[cursor.part];
+	Real local = length - cursor.partStart;
+	if (local < (Real)0.0) local = (Real)0.0;
+	if (local > lp.length) local = lp.length;
+
+	cursor.length = length;
+	cursor.param = _getWarmParam(lp, cursor.param, lastLocal, local);
+
+	_evaluate(m_partControls[cursor.part], cursor.param, point, tangent);
+	_normalize(tangent);
+
+	return moving;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+bool BlineT<T>::advanceTime(Cursor& cursor, Real time, Point& point, Point& tangent) const
+{
+	Real distance = cursor.speed*time + cursor.acceleration*time*time / 2;
+	cursor.speed += cursor.acceleration*time;
+	return advance(cursor, distance, point, tangent);
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_getFirstNormal(const Point& tangent, const Point& up, Point& normal)
+{
+	//up without its part along the tangent, or the axis farthest from the tangent when up
+	//is (nearly) parallel to it
+	Point axis = up;
+	for (int tries = 0; tries < 2; tries++) {
+		Real d = axis.x*tangent.x + axis.y*tangent.y + axis.z*tangent.z;
+		normal.x = axis.x - d*tangent.x;
+		normal.y = axis.y - d*tangent.y;
+		normal.z = axis.z - d*tangent.z;
+
+		Real nn = normal.x*normal.x + normal.y*normal.y + normal.z*normal.z;
+		Real aa = axis.x*axis.x + axis.y*axis.y + axis.z*axis.z;
+		if (nn > (Real)0.0001 * aa && nn > (Real)0.0) {
+			nn = sqrt(nn);
+			normal.x /= nn; normal.y /= nn; normal.z /= nn;
+			return;
+		}
+
+		Real ax = fabs(tangent.x), ay = fabs(tangent.y), az = fabs(tangent.z);
+		axis.x = axis.y = axis.z = (Real)0.0;
+		if (ax <= ay && ax <= az) axis.x = (Real)1.0;
+		else if (ay <= az) axis.y = (Real)1.0;
+		else axis.z = (Real)1.0;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineT<T>::_layoutImage(ImageHeader& header, uint64_t* arrayBytes)
+{
+	header.sizes[0] = (uint32_t)sizeof(Real);
+	header.sizes[1] = (uint32_t)sizeof(size_t);
+	header.sizes[2] = (uint32_t)sizeof(Point);
+	header.sizes[3] = (uint32_t)sizeof(LinePart);
+	header.sizes[4] = (uint32_t)sizeof(PartControl);
+	header.sizes[5] = (uint32_t)sizeof(Box);
+
+	uint64_t bytes[6] = {
+		header.keyCounts*sizeof(Point),
+		header.partCounts*sizeof(LinePart),
+		header.partCounts*sizeof(PartControl),
+		header.lengthTreeSize*sizeof(Real),
+		header.bvhLeaves * 2 * sizeof(Box),
+		header.invertTableSize*sizeof(Real),
+	};
+	if (arrayBytes) memcpy(arrayBytes, bytes, sizeof(bytes));
+
+	//every array on its own cache line, empty ones take no room
+	uint64_t offset = sizeof(ImageHeader);
+	for (int i = 0; i < 6; i++) {
+		offset = (offset + IMAGE_ALIGNMENT - 1) & ~(uint64_t)(IMAGE_ALIGNMENT - 1);
+		header.offsets[i] = offset;
+		offset += bytes[i];
+	}
+	header.bytes = offset;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+size_t BlineT<T>::getImageBytes(void) const
+{
+	ImageHeader header;
+	header.keyCounts = m_keyCounts;
+	header.partCounts = m_partCounts;
+	header.lengthTreeSize = m_lengthTree ? m_lengthTreeSize : 0;
+	header.bvhLeaves = m_bvh ? m_bvhLeaves : 0;
+	header.invertTableSize = m_invertTable ? m_invertTableSize : 0;
+	_layoutImage(header);
+	return (size_t)header.bytes;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+bool BlineT<T>::saveImage(void* image, size_t bytes) const
+{
+	ImageHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "BLIN", 4);
+	header.version = IMAGE_VERSION;
+	header.byteOrder = IMAGE_BYTE_ORDER;
+	header.lengthMode = (uint32_t)m_lengthMode;
+	header.fastInvert = (m_fastInvert ? 1 : 0) | (m_fastInvertPolish ? 2 : 0);
+	header.keyCounts = m_keyCounts;
+	header.partCounts = m_partCounts;
+	header.lengthTreeSize = m_lengthTree ? m_lengthTreeSize : 0;
+	header.bvhLeaves = m_bvh ? m_bvhLeaves : 0;
+	header.invertTableSize = m_invertTable ? m_invertTableSize : 0;
+	header.invertNewtonParts = m_invertNewtonParts;
+	header.totalLength = (double)m_totalLength;
+	header.fastInvertError = (double)m_fastInvertError;
+	header.invertTableError = (double)m_invertTableError;
+	uint64_t arrayBytes[6];
+	_layoutImage(header, arrayBytes);
+
+	if (bytes < header.bytes) return false;
+
+	//padding is zeroed, the same line always gives the same bytes
+	char* base = (char*)image;
+	memset(base, 0, (size_t)header.bytes);
+	memcpy(base, &header, sizeof(header));
+
+	const void* arrays[6] = { m_keyPoints, m_parts, m_partControls, m_lengthTree, m_bvh, m_invertTable };
+	for (int i = 0; i < 6; i++) {
+		if (arrayBytes[i] > 0) memcpy(base + header.offsets[i], arrays[i], (size_t)arrayBytes[i]);
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+bool BlineT<T>::loadImage(const void* image, size_t bytes)
+{
+	if (((uintptr_t)image & (IMAGE_ALIGNMENT - 1)) != 0 || bytes < sizeof(ImageHeader)) return false;
+
+	const ImageHeader& header = *(const ImageHeader*)image;
+	if (memcmp(header.magic, "BLIN", 4) != 0 || header.version != IMAGE_VERSION) return false;
+	if (header.byteOrder != IMAGE_BYTE_ORDER) return false;
+	if (header.lengthMode > LM_QUADRATURE) return false;
+
+	//counts must be those of a line, the tree and the bvh powers of two covering the parts
+	uint64_t partCounts = (header.keyCounts >= 3) ? header.keyCounts - 2 : 0;
+	if (header.partCounts != partCounts) return false;
+	if (partCounts > 0) {
+		if (header.lengthTreeSize < partCounts || (header.lengthTreeSize & (header.lengthTreeSize - 1)) != 0) return false;
+		if (header.bvhLeaves < partCounts || (header.bvhLeaves & (header.bvhLeaves - 1)) != 0) return false;
+	}
+
+	//the layout this build would write for the same counts, sizes of the records included
+	ImageHeader layout = header;
+	_layoutImage(layout);
+	if (memcmp(layout.sizes, header.sizes, sizeof(header.sizes)) != 0) return false;
+	if (memcmp(layout.offsets, header.offsets, sizeof(header.offsets)) != 0) return false;
+	if (layout.bytes != header.bytes || header.bytes > bytes) return false;
+
+	release();
+	m_image = true;
+
+	const char* base = (const char*)image;
+	m_keyPoints = header.keyCounts ? (Point*)(base + header.offsets[0]) : nullptr;
+	m_parts = partCounts ? (LinePart*)(base + header.offsets[1]) : nullptr;
+	m_partControls = partCounts ? (PartControl*)(base + header.offsets[2]) : nullptr;
+	m_lengthTree = header.lengthTreeSize ? (Real*)(base + header.offsets[3]) : nullptr;
+	m_bvh = header.bvhLeaves ? (Box*)(base + header.offsets[4]) : nullptr;
+	m_invertTable = header.invertTableSize ? (Real*)(base + header.offsets[5]) : nullptr;
+
+	m_keyCounts = (size_t)header.keyCounts;
+	m_keyCapacity = m_keyCounts;
+	m_partCounts = (size_t)partCounts;
+	m_totalLength = (Real)header.totalLength;
+	m_lengthTreeSize = (size_t)header.lengthTreeSize;
+	m_bvhLeaves = (size_t)header.bvhLeaves;
+	m_invertTableSize = m_invertTableCapacity = (size_t)header.invertTableSize;
+	m_invertTableError = (Real)header.invertTableError;
+	m_invertNewtonParts = (size_t)header.invertNewtonParts;
+
+	m_lengthMode = (LengthMode)header.lengthMode;
+	m_fastInvert = (header.fastInvert & 1) != 0;
+	m_fastInvertPolish = (header.fastInvert & 2) != 0;
+	m_fastInvertError = (Real)header.fastInvertError;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+template class BlineT<float>;
+template class BlineT<double>;
@@ -1,56 +1,418 @@
 #pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
 
-class Bline
+//where the memory of a line comes from, see BlineT::setAllocator. the calls match
+//std::pmr::memory_resource, so a memory resource is wrapped by forwarding both. as there,
+//alignment is a power of two and must be honoured, the default does for any
+class BlineAllocator
 {
 public:
-	typedef double Real;
+	virtual void* allocate(size_t bytes, size_t alignment) = 0;
+	virtual void deallocate(void* p, size_t bytes, size_t alignment) = 0;
+
+	//operator new and delete
+	static BlineAllocator* getDefault(void);
+
+public:
+	virtual ~BlineAllocator() {}
+};
+
+//precision dependent constants of BlineT
+template<typename T>
+struct BlineTraits;
+
+template<>
+struct BlineTraits<double>
+{
+	static double invertTolerance(void) { return 0.000001; }
+	//relative off-line acceleration still treated as straight
+	static double straightEpsilon(void) { return 1e-12; }
+	//A/C below which the closed form length cancels too much
+	static double nearStraightRatio(void) { return 1e-6; }
+};
+
+template<>
+struct BlineTraits<float>
+{
+	static float invertTolerance(void) { return 0.00001f; }
+	static float straightEpsilon(void) { return 1e-6f; }
+	static float nearStraightRatio(void) { return 1e-3f; }
+};
+
+template<typename T>
+class BlineT
+{
+public:
+	typedef T Real;
 
 	struct Point
 	{
 		Real x, y, z;
 	};
 
+	//what the arc-length inversion of one getPoint call cost
+	struct InvertStats
+	{
+		unsigned int iterations;
+		unsigned int fallbacks;	//steps where Newton left the bracket
+		bool converged;
+	};
+
+	//closest point of the line to a query point
+	struct Projection
+	{
+		Real t;			//as getPoint takes it, length over the total length
+		Real length;	//from the beginning of the line
+		Point point;
+		Real distance;
+	};
+
+	//structure-of-arrays view on caller-owned buffers
+	struct PointArray
+	{
+		Real* x;
+		Real* y;
+		Real* z;
+	};
+
+	//where a walk of getFrames is, see beginFrames
+	struct FrameCursor
+	{
+		Real step;
+		size_t index;		//of the next frame
+		size_t counts;		//of the whole walk
+		Point up;
+
+		size_t part;
+		Real partStart, partEnd;
+		Real param, length;	//of the frame before
+		Point point, tangent, normal;
+	};
+
+	//a point moving along the line, see setCursor
+	struct Cursor
+	{
+		Real length;		//from the beginning of the line
+		Real speed;			//per unit of time, for advanceTime
+		Real acceleration;
+
+		size_t part;
+		Real partStart, partEnd;
+		Real param;			//bezier parameter in the part
+	};
+
+	//scalar type of the keys in a strided caller buffer
+	enum ComponentType
+	{
+		CT_FLOAT,
+		CT_DOUBLE,
+	};
+
+	enum LengthMode
+	{
+		LM_PLANAR,		//closed form on x and y only
+		LM_SPATIAL,		//closed form on x, y and z
+		LM_QUADRATURE,	//x, y and z by composite gauss-legendre, to cross check LM_SPATIAL
+	};
+
+	//built line shared by reference count, a const line may be sampled by any number of
+	//threads at once
+	typedef std::shared_ptr<const BlineT> Snapshot;
+
+	//frees all memory, build() keeps it instead and only grows it
 	void release(void);
-	bool build(const Real* keyPoints, unsigned int keyCounts);
+	//takes 3 keys at least, false and the line left as it was otherwise
+	bool build(const Real* keyPoints, size_t keyCounts);
+	//keys are x, y, z of the given type at base + i*stride (in bytes), as in an interleaved
+	//vertex buffer. they are converted while copied, so no packed copy is needed first
+	bool build(const void* base, size_t stride, ComponentType type, size_t keyCounts);
 
+	//exact box of the curve, not of the keys. an empty line gives min above max
 	void	getBounder(Point& min, Point& max) const;
+	//exact box of one part
+	void	getPartBounder(size_t index, Point& min, Point& max) const;
+	size_t	getPartCounts(void) const { return m_partCounts; }
+	Real	getTotalLength(void) const { return m_totalLength; }
+	Real	getPartLength(size_t index) const;
 	size_t	getKeyCounts(void) const { return m_keyCounts; }
-	Point*	getKeys(void) const { return m_keyPoints; }
-	void	getPoint(Real t, Point& point, Point& tangent) const;
+	//read only, keys are moved by setKey, and on a loaded image they sit in a read only mapping
+	const Point* getKeys(void) const { return m_keyPoints; }
+	//moves one key of a built line, only the (at most three) parts using it are rebuilt.
+	//their fast inverse tables are refitted too, a part needing more knots than before
+	//moves them to the tail of the table, and the table is compacted once full
+	bool	setKey(size_t index, const Point& point);
+	//adds one key at the tail, only the last two parts are rebuilt and the storage grows
+	//geometrically, so feeding a line key by key is amortized O(1) per key. until the third
+	//key the line has no part, getPoint then gives the only key with a zero tangent, or the
+	//segment between the two keys. arc length queries see a line of length 0
+	bool	appendKey(const Point& point);
+	void	getPoint(Real t, Point& point, Point& tangent, InvertStats* stats = nullptr) const;
+	void	getPoints(const Real* t, size_t counts, const PointArray& points, const PointArray& tangents) const;
+	//closest point of the line, exact up to rounding. parts are culled by a bounding volume
+	//hierarchy and the few left are solved in closed form
+	bool	project(const Point& point, Projection& result) const;
+	//polyline within tolerance of the curve. every part is cut into the fewest uniform steps
+	//of its bezier parameter which keep the chord error below tolerance, for a quadratic
+	//that is exactly |p0 - 2p1 + p2| / 4n^2, so straight runs take one step and bends more.
+	//writes the first capacity points, and t of each as getPoint takes it when t is given.
+	//returns the counts of the whole polyline, a call with capacity 0 sizes the buffers
+	size_t	tessellate(Real tolerance, const PointArray& points, size_t capacity, Real* t = nullptr) const;
+	//rotation minimizing frames every step of arc length, and one at the end, by double
+	//reflection. the first normal is up made perpendicular to the first tangent, the
+	//binormal of a frame is tangent x normal. the parts are walked in one pass and each
+	//inversion starts from the parameter of the frame before, so most take one Newton step.
+	//writes the first capacity frames and returns the counts of the whole sequence
+	size_t	getFrames(Real step, const Point& up, const PointArray& points, const PointArray& tangents, const PointArray& normals, size_t capacity) const;
+	//the same walk a chunk at a time, nextFrames writes the frames after the cursor and
+	//returns their counts, 0 once the walk is done
+	void	beginFrames(Real step, const Point& up, FrameCursor& cursor) const;
+	size_t	nextFrames(FrameCursor& cursor, const PointArray& points, const PointArray& tangents, const PointArray& normals, size_t capacity) const;
+	//places a cursor at length from the beginning, at rest
+	void	setCursor(Real length, Cursor& cursor) const;
+	//moves a cursor by distance, backwards when negative, and gives its new point. parts
+	//are stepped across one by one and the inversion starts from the parameter before, so
+	//a move shorter than a part is O(1). false when the cursor stopped at an end
+	bool	advance(Cursor& cursor, Real distance, Point& point, Point& tangent) const;
+	//moves by speed*time + acceleration*time^2/2 and then updates the speed
+	bool	advanceTime(Cursor& cursor, Real time, Point& point, Point& tangent) const;
+
+	//arc length queries. the raw parameter of the line is the part index plus the bezier
+	//parameter in the part, from 0 to getPartCounts(), getPoint takes length over the total
+	//length instead. all are O(log n)
+	Real	getLength(Real param) const;
+	Real	getParam(Real length) const;
+	//part at the length, and the bezier parameter in it. 0 on a line without parts
+	size_t	getPartAt(Real length, Real& param) const;
+	//batches of getLength and getParam. ascending input walks the parts forward, a part is
+	//only searched when the one before is left, and the inversion starts from the sample
+	//before. getLengths gives the same bits as getLength
+	void	getLengths(const Real* params, size_t counts, Real* lengths) const;
+	void	getParams(const Real* lengths, size_t counts, Real* params) const;
+
+	//how build() measures arc length, must be set before build()
+	void	setLengthMode(LengthMode mode) { m_lengthMode = mode; }
+	LengthMode getLengthMode(void) const { return m_lengthMode; }
+	//largest relative difference between the built part lengths and an independent quadrature
+	Real	checkLength(void) const;
+
+	//hard ceiling of the arc-length inversion per sample
+	void	setMaxIterations(unsigned int maxIterations) { m_maxIterations = maxIterations; }
+
+	//moves the line into a new snapshot without copying any part, this line is left empty
+	//with its settings kept
+	Snapshot share(void);
+
+	//frees the memory held so far, then takes everything from allocator. nullptr sets the
+	//default one. the allocator must outlive the line
+	void	setAllocator(BlineAllocator* allocator);
+
+	//threads used by build(), 0 means one per hardware thread, at most MAX_THREADS. the
+	//result does not depend on the thread counts, bit for bit
+	enum { MAX_THREADS = 64 };
+	void	setThreadCounts(unsigned int threadCounts) { m_threadCounts = threadCounts; }
+
+	//fast inverse mode, build() fits t(s) of every part into a monotone cubic table so
+	//getPoint needs no Newton iteration, optionally followed by one polish step.
+	//must be set before build(), or before the first part of a line fed by appendKey
+	void	setFastInvert(bool enable, Real maxError = (Real)0.0001, bool polish = false);
+	//memory used by the tables, the worst parameter error found while fitting them and
+	//the counts of parts too steep to tabulate, which keep using Newton
+	void	getFastInvertInfo(size_t& bytes, Real& maxError, size_t& newtonParts) const;
+
+	//how build() classified the parts, straight parts need no transcendental call at all.
+	//quadrature parts of LM_QUADRATURE count as general
+	void	getPartTypeCounts(size_t& straight, size_t& nearStraight, size_t& general) const;
+
+	//binary image of the built line, to be written to a file and mapped back. it is the
+	//memory of the line as it is, keys, parts, length tree, bvh and fast inverse tables,
+	//each IMAGE_ALIGNMENT aligned, after a header with the version, the byte order and the
+	//sizes of the records. getImageBytes is what saveImage needs
+	enum { IMAGE_VERSION = 1, IMAGE_ALIGNMENT = 64 };
+	size_t	getImageBytes(void) const;
+	bool	saveImage(void* image, size_t bytes) const;
+	//uses an image in place, nothing is parsed or copied, so a mapped file is ready after
+	//the header checks and its pages are only read when sampled. the image must be
+	//IMAGE_ALIGNMENT aligned, as a mapping is, and outlive the line or its next build().
+	//false, and the line left as it was, when the image comes from another version, byte
+	//order, precision or record layout, it must then be built from its keys again. the
+	//arrays themselves are trusted. a loaded line is read only, setKey and appendKey fail
+	bool	loadImage(const void* image, size_t bytes);
+	bool	isImage(void) const { return m_image; }
 
 private:
 	Point*		m_keyPoints;
 	size_t		m_keyCounts;
-	Point		m_bounderMin;
-	Point		m_bounderMax;
+	size_t		m_keyCapacity;	//of keys, parts and controls have two less
+
+	enum PartType
+	{
+		PT_STRAIGHT,		//collinear, speed is linear in t
+		PT_NEAR_STRAIGHT,	//almost no curvature, closed form loses precision
+		PT_GENERAL,
+		PT_QUADRATURE,		//LM_QUADRATURE, any part not straight
+	};
+
+	//parts are stored as three parallel arrays so every stage of a sample only pulls the
+	//cache lines it needs: the search reads m_lengthTree, the arc-length inversion reads
+	//m_parts and the bezier evaluation reads m_partControls
 
+	//length cache
 	struct LinePart
 	{
-		Point pt0;
-		Point pt1;
-		Point pt2;
 		Real length;
+		PartType type;
 
-		//Cache
 		Real A, B, C;
 		Real sqrt_A, sqrt_C, D, E;
 
-		//proportion
-		Real percent;
-		Real percentAddup;
+		//fast inverse table
+		size_t invertOffset;
+		size_t invertCounts;
+	};
+
+	struct PartControl
+	{
+		Point pt0;
+		Point pt1;
+		Point pt2;
 	};
 
-	LinePart*	m_parts;
-	size_t		m_partCounts;
-	Real		m_totalLength;
+	LinePart*		m_parts;
+	PartControl*	m_partControls;
+	size_t			m_partCounts;
+	Real			m_totalLength;
+
+	struct Box
+	{
+		Point min;
+		Point max;
+	};
+
+	//bounding volume hierarchy over the parts in line order, a complete binary tree as an
+	//array, leaves are the exact boxes of the parts, node 1 is the root and the box of the
+	//whole curve, the children of node i are 2i and 2i+1, the leaves start at
+	//m_bvhLeaves, a power of two. leaves past the last part hold empty boxes
+	Box*		m_bvh;
+	size_t		m_bvhLeaves;
+
+	//search index, fenwick tree over the part lengths padded to a power of two with
+	//infinite nodes, so setKey updates it and _findPart descends it in O(log n)
+	Real*		m_lengthTree;
+	size_t		m_lengthTreeSize;
+
+	LengthMode		m_lengthMode;
+	unsigned int	m_maxIterations;
+	unsigned int	m_threadCounts;
+	BlineAllocator*	m_allocator;
+
+	//fast inverse, knots of all parts as (t, dt/ds) pairs
+	bool		m_fastInvert;
+	bool		m_fastInvertPolish;
+	Real		m_fastInvertError;
+	Real*		m_invertTable;
+	size_t		m_invertTableSize;
+	size_t		m_invertTableCapacity;
+	Real		m_invertTableError;
+	size_t		m_invertNewtonParts;
+
+	//the arrays are a loaded image, not taken from the allocator
+	bool		m_image;
+
+	//all fixed width, in the byte order of the writer
+	struct ImageHeader
+	{
+		char		magic[4];		//"BLIN"
+		uint32_t	version;
+		uint32_t	byteOrder;		//IMAGE_BYTE_ORDER as the writer stores it
+		uint32_t	sizes[6];		//of Real, size_t, Point, LinePart, PartControl and Box
+		uint32_t	lengthMode;
+		uint32_t	fastInvert;		//bit 0 enabled, bit 1 polish
+		uint64_t	bytes;			//of the whole image
+		uint64_t	keyCounts;
+		uint64_t	partCounts;
+		uint64_t	lengthTreeSize;
+		uint64_t	bvhLeaves;
+		uint64_t	invertTableSize;
+		uint64_t	invertNewtonParts;
+		uint64_t	offsets[6];		//of keys, parts, controls, length tree, bvh and invert table
+		double		totalLength;
+		double		fastInvertError;
+		double		invertTableError;
+	};
+
+	enum : uint32_t { IMAGE_BYTE_ORDER = 0x01020304 };
 
 private:
 	static void _middle(const Point& pt1, const Point& pt2, Point& middle);
 	static void _normalize(Point& vector);
 	static Real _getlength(const LinePart& lp, Real t);
-	static Real _getInvertLength(const LinePart& lp, Real t, Real length);
+	static Real _getInvertLength(const LinePart& lp, Real t, Real length, unsigned int maxIterations, InvertStats* stats);
+	static Real _getSpeed(const LinePart& lp, Real t);
+	static Real _getQuadratureLength(const LinePart& lp, Real t0, Real t1);
+	static Real _getCompositeLength(const LinePart& lp, Real t, size_t panels);
+	static void _getStraightSpeed(const LinePart& lp, Real& c0, Real& k);
+	static Real _getStraightInvert(const LinePart& lp, Real length);
+	static Real _getTableInvert(const Real* knots, size_t counts, Real percent);
+	static int _solveCubic(Real a, Real b, Real c, Real d, Real roots[3]);
+	static Real _getPartDistance(const PartControl& pc, const Point& point, Real& t);
+	static Real _getBoxDistance(const Box& box, const Point& point);
+	static void _getPartBox(const PartControl& pc, Box& box);
+	static void _mergeBox(const Box& a, const Box& b, Box& box);
+	static void _getFirstNormal(const Point& tangent, const Point& up, Point& normal);
+	//point and tangent of a part at u, the tangent not normalized
+	static void _evaluate(const PartControl& pc, Real u, Point& point, Point& tangent);
+
+	void _buildPart(size_t index);
+	static void _expandBounder(const Point& point, Point& min, Point& max);
+	template<typename U> U* _allocate(size_t counts) const;
+	template<typename U> void _deallocate(U*& p, size_t counts) const;
+	void _reset(void);
+	void _reserveKeys(size_t keyCounts);
+	void _reserveLengthTree(size_t partCounts);
+	void _addPartLength(size_t index, Real delta);
+	void _setPartLength(size_t index);
+	size_t _getThreadCounts(size_t counts) const;
+	void _buildLengthTree(size_t threads);
+	void _buildBvh(size_t threads);
+	void _updateBvh(size_t index);
+	void _buildInvertTable(size_t threads);
+	void _reserveInvertTable(size_t size);
+	//drops the slots left by refits which moved, with room for extra more
+	void _compactInvertTable(size_t extra);
+	size_t _fitInvertTable(const LinePart& lp, Real* knots, Real& error) const;
+	void _refitInvertTable(size_t index, bool newton);
+	Real _getPartParam(const LinePart& lp, Real percent, InvertStats* stats) const;
+	//the same, warm started from the parameter param at the local length lastLocal nearby
+	Real _getWarmParam(const LinePart& lp, Real param, Real lastLocal, Real local) const;
+	void _getPartPoint(size_t partIndex, Real percent, Point& point, Point& tangent, InvertStats* stats) const;
+
+	void _getHeadPoint(Point& point, Point& tangent) const;
+	void _getTailPoint(Point& point, Point& tangent) const;
+	//of a line of less than 3 keys, which has no part
+	void _getShortPoint(Real t, Point& point, Point& tangent) const;
+	size_t _findPart(Real length, Real& startLength) const;
+	Real _getStartLength(size_t index) const;
+
+	void _swap(BlineT& other);
+	//record sizes and offsets of the image from its counts, and the bytes of each array
+	static void _layoutImage(ImageHeader& header, uint64_t* arrayBytes = nullptr);
 
 public:
-	Bline();
-	virtual ~Bline();
-};
\ No newline at end of file
+	BlineT();
+	//moves never throw, so std::vector of lines moves them when it grows. the line moved
+	//from is left empty, a line moved into frees its old memory first
+	BlineT(BlineT&& other) noexcept;
+	BlineT& operator=(BlineT&& other) noexcept;
+	virtual ~BlineT();
+
+private:
+	//lines own their memory, copies would free it twice
+	BlineT(const BlineT&) = delete;
+	BlineT& operator=(const BlineT&) = delete;
+};
+
+//double for authoring and precision critical paths, float for rendering
+typedef BlineT<double> Bline;
+typedef BlineT<float> BlineF;
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "bl_mesh.h"
+#include <assert.h>
+#include <math.h>
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+BlineMeshT<T>::BlineMeshT()
+	: m_shape(MS_TUBE)
+	, m_radius((Real)1.0)
+	, m_sides(0)
+	, m_step((Real)1.0)
+	, m_line(nullptr)
+	, m_done(true)
+	, m_frameFirst(0)
+	, m_frameCounts(0)
+	, m_frameNext(0)
+	, m_hasRing(false)
+	, m_ringIndex(0)
+{
+	m_up.x = m_up.z = (Real)0.0;
+	m_up.y = (Real)1.0;
+	setSides(8);
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineMeshT<T>::setSides(unsigned int sides)
+{
+	assert(sides >= 3 && sides <= MAX_SIDES);
+	m_sides = sides;
+
+	//the seam is written twice, with v of 0 and 1
+	const Real pi = (Real)3.14159265358979323846;
+	for (unsigned int i = 0; i <= sides; i++) {
+		Real angle = 2 * pi*(Real)(i % sides) / (Real)sides;
+		m_cos[i] = cos(angle);
+		m_sin[i] = sin(angle);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineMeshT<T>::getMeshCounts(const Line& line, size_t& vertexCounts, size_t& indexCounts) const
+{
+	typename Line::PointArray none = { nullptr, nullptr, nullptr };
+	size_t rings = line.getFrames(m_step, m_up, none, none, none, 0);
+
+	vertexCounts = rings*getRingVertexCounts();
+	indexCounts = (rings > 0) ? (rings - 1)*getSpanIndexCounts() : 0;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineMeshT<T>::begin(const Line& line)
+{
+	m_line = &line;
+	line.beginFrames(m_step, m_up, m_cursor);
+
+	m_done = (m_cursor.counts == 0);
+	m_frameFirst = m_frameCounts = m_frameNext = 0;
+	m_hasRing = false;
+	m_ringIndex = 0;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+bool BlineMeshT<T>::_nextFrame(Real* frame, size_t& index)
+{
+	if (m_frameNext == m_frameCounts) {
+		m_frameFirst = m_cursor.index;
+		typename Line::PointArray points = { m_frames[0], m_frames[1], m_frames[2] };
+		typename Line::PointArray tangents = { m_frames[3], m_frames[4], m_frames[5] };
+		typename Line::PointArray normals = { m_frames[6], m_frames[7], m_frames[8] };
+		m_frameCounts = m_line->nextFrames(m_cursor, points, tangents, normals, FRAME_CHUNK);
+		m_frameNext = 0;
+		if (m_frameCounts == 0) return false;
+	}
+
+	for (int i = 0; i < 9; i++) {
+		frame[i] = m_frames[i][m_frameNext];
+	}
+	index = m_frameFirst + m_frameNext;
+	m_frameNext++;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineMeshT<T>::_writeRing(const Real* frame, size_t index, Vertex* vertices) const
+{
+	const Real* p = frame;
+	const Real* t = frame + 3;
+	const Real* n = frame + 6;
+
+	//binormal, t x n
+	Real b[3] = { t[1] * n[2] - t[2] * n[1], t[2] * n[0] - t[0] * n[2], t[0] * n[1] - t[1] * n[0] };
+
+	Real length = (index + 1 < m_cursor.counts) ? (Real)index * m_step : m_line->getTotalLength();
+
+	if (m_shape == MS_RIBBON) {
+		for (int side = 0; side < 2; side++) {
+			Real s = side ? m_radius : -m_radius;
+			Vertex& v = vertices[side];
+			for (int k = 0; k < 3; k++) {
+				v.position[k] = (float)(p[k] + s*b[k]);
+				v.normal[k] = (float)n[k];
+			}
+			v.u = (float)length;
+			v.v = (float)side;
+		}
+		return;
+	}
+
+	for (unsigned int j = 0; j <= m_sides; j++) {
+		Vertex& v = vertices[j];
+		for (int k = 0; k < 3; k++) {
+			Real d = m_cos[j] * n[k] + m_sin[j] * b[k];
+			v.position[k] = (float)(p[k] + m_radius*d);
+			v.normal[k] = (float)d;
+		}
+		v.u = (float)length;
+		v.v = (float)j / (float)m_sides;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+bool BlineMeshT<T>::next(Vertex* vertices, size_t vertexCapacity, uint32_t* indices, size_t indexCapacity, size_t& vertexCounts, size_t& indexCounts)
+{
+	vertexCounts = indexCounts = 0;
+	if (m_done || m_line == nullptr) return false;
+
+	size_t ringVertices = getRingVertexCounts();
+	size_t spanIndices = getSpanIndexCounts();
+
+	size_t maxRings = vertexCapacity / ringVertices;
+	if (maxRings > indexCapacity / spanIndices + 1) maxRings = indexCapacity / spanIndices + 1;
+	assert(maxRings >= 2);
+	if (maxRings < 2) return false;
+
+	size_t rings = 0;
+	if (m_hasRing) {
+		_writeRing(m_ring, m_ringIndex, vertices);
+		rings++;
+	}
+
+	Real frame[9];
+	size_t index;
+	while (rings < maxRings && _nextFrame(frame, index)) {
+		_writeRing(frame, index, vertices + rings*ringVertices);
+
+		if (rings > 0) {
+			uint32_t* span = indices + (rings - 1)*spanIndices;
+			uint32_t first = (uint32_t)((rings - 1)*ringVertices);
+			uint32_t second = (uint32_t)(rings*ringVertices);
+
+			//the two triangles of a quad, the winding follows from n x b = t
+			size_t quads = (m_shape == MS_TUBE) ? m_sides : 1;
+			for (size_t j = 0; j < quads; j++) {
+				uint32_t a = first + (uint32_t)j, b = a + 1;
+				uint32_t c = second + (uint32_t)j, d = c + 1;
+				span[j * 6 + 0] = a; span[j * 6 + 1] = b; span[j * 6 + 2] = c;
+				span[j * 6 + 3] = b; span[j * 6 + 4] = d; span[j * 6 + 5] = c;
+			}
+		}
+
+		for (int i = 0; i < 9; i++) m_ring[i] = frame[i];
+		m_ringIndex = index;
+		m_hasRing = true;
+		rings++;
+	}
+
+	if (m_ringIndex + 1 >= m_cursor.counts) m_done = true;
+
+	vertexCounts = rings*ringVertices;
+	indexCounts = (rings > 0) ? (rings - 1)*spanIndices : 0;
+	return rings > 1;
+}
+
+//--------------------------------------------------------------------------------------
+template class BlineMeshT<float>;
+template class BlineMeshT<double>;
@@ -0,0 +1,90 @@
+#pragma once
+#include "bl_line.h"
+#include <stdint.h>
+
+//Tubes and ribbons swept along a line, a chunk at a time into caller buffers.
+//A ring of vertices is laid on the rotation minimizing frame every step of arc length.
+//Every chunk is a complete indexed triangle list counted from vertex 0, and its first ring
+//repeats the last ring of the chunk before, so the chunks of a long line can go one after
+//the other through one fixed vertex buffer. Nothing is allocated while meshing.
+template<typename T>
+class BlineMeshT
+{
+public:
+	typedef BlineT<T> Line;
+	typedef typename Line::Real Real;
+	typedef typename Line::Point Point;
+
+	//u is the arc length along the line, v runs around the tube or across the ribbon
+	struct Vertex
+	{
+		float position[3];
+		float normal[3];
+		float u, v;
+	};
+
+	enum Shape
+	{
+		MS_TUBE,	//sides quads around the line
+		MS_RIBBON,	//flat strip along the binormal, facing the frame normal
+	};
+
+	enum { MAX_SIDES = 256 };
+
+	//all must be set before begin(). radius is half the width of a ribbon, up the first
+	//normal as getFrames takes it
+	void	setShape(Shape shape) { m_shape = shape; }
+	void	setRadius(Real radius) { m_radius = radius; }
+	void	setSides(unsigned int sides);
+	void	setStep(Real step) { m_step = step; }
+	void	setUp(const Point& up) { m_up = up; }
+
+	//vertices of one ring, and indices of the triangles between two rings
+	size_t	getRingVertexCounts(void) const { return (m_shape == MS_TUBE) ? m_sides + 1 : 2; }
+	size_t	getSpanIndexCounts(void) const { return (m_shape == MS_TUBE) ? m_sides * 6 : 6; }
+	//of the whole line as a single chunk
+	void	getMeshCounts(const Line& line, size_t& vertexCounts, size_t& indexCounts) const;
+
+	//starts meshing a line, which must outlive the meshing
+	void	begin(const Line& line);
+	//the next chunk, as many rings as fit into both buffers, which must take two rings at
+	//least. triangles are counter clockwise seen from outside. returns false once the
+	//whole line has been written
+	bool	next(Vertex* vertices, size_t vertexCapacity, uint32_t* indices, size_t indexCapacity, size_t& vertexCounts, size_t& indexCounts);
+
+private:
+	enum { FRAME_CHUNK = 64 };
+
+	Shape			m_shape;
+	Real			m_radius;
+	unsigned int	m_sides;
+	Real			m_step;
+	Point			m_up;
+	Real			m_cos[MAX_SIDES + 1];
+	Real			m_sin[MAX_SIDES + 1];
+
+	const Line*		m_line;
+	typename Line::FrameCursor m_cursor;
+	bool			m_done;
+
+	//frames of the walk not written yet, structure of arrays
+	Real			m_frames[9][FRAME_CHUNK];
+	size_t			m_frameFirst;	//index in the walk of m_frames[..][0]
+	size_t			m_frameCounts;
+	size_t			m_frameNext;	//in m_frames
+
+	//the last ring written, the first of the next chunk
+	bool			m_hasRing;
+	Real			m_ring[9];
+	size_t			m_ringIndex;
+
+private:
+	bool _nextFrame(Real* frame, size_t& index);
+	void _writeRing(const Real* frame, size_t index, Vertex* vertices) const;
+
+public:
+	BlineMeshT();
+};
+
+typedef BlineMeshT<double> BlineMesh;
+typedef BlineMeshT<float> BlineMeshF;
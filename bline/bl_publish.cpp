@@ -0,0 +1,136 @@
+#include "bl_publish.h"
+#include <assert.h>
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+BlinePublisherT<T>::BlinePublisherT()
+	: m_current(nullptr)
+	, m_epoch(0)
+{
+	for (size_t i = 0; i < MAX_READERS; i++) {
+		m_slots[i].epoch = IDLE;
+		m_slots[i].used = false;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+BlinePublisherT<T>::~BlinePublisherT()
+{
+	//readers are gone by now
+	for (size_t i = 0; i < m_retired.size(); i++) {
+		delete m_retired[i].line;
+	}
+	delete m_current.load();
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlinePublisherT<T>::publish(Line&& line)
+{
+	const Line* fresh = new Line(std::move(line));
+
+	std::lock_guard<std::mutex> lock(m_writerLock);
+
+	//a reader which announced this epoch or an older one may still hold the old line,
+	//one entering after the increment loads the fresh line
+	const Line* old = m_current.exchange(fresh);
+	uint64_t epoch = m_epoch.fetch_add(1);
+
+	if (old) {
+		Retired retired = { old, epoch };
+		m_retired.push_back(retired);
+	}
+	_reclaim();
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlinePublisherT<T>::reclaim(void)
+{
+	std::lock_guard<std::mutex> lock(m_writerLock);
+	_reclaim();
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlinePublisherT<T>::_reclaim(void)
+{
+	uint64_t oldest = IDLE;
+	for (size_t i = 0; i < MAX_READERS; i++) {
+		uint64_t epoch = m_slots[i].epoch;
+		if (epoch < oldest) oldest = epoch;
+	}
+
+	size_t kept = 0;
+	for (size_t i = 0; i < m_retired.size(); i++) {
+		if (m_retired[i].epoch < oldest) {
+			delete m_retired[i].line;
+		}
+		else {
+			m_retired[kept++] = m_retired[i];
+		}
+	}
+	m_retired.resize(kept);
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+size_t BlinePublisherT<T>::getRetiredCounts(void) const
+{
+	std::lock_guard<std::mutex> lock(m_writerLock);
+	return m_retired.size();
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+BlinePublisherT<T>::Reader::Reader(BlinePublisherT& publisher)
+	: m_publisher(publisher)
+	, m_slot(MAX_READERS)
+{
+	for (size_t i = 0; i < MAX_READERS; i++) {
+		bool expected = false;
+		if (publisher.m_slots[i].used.compare_exchange_strong(expected, true)) {
+			m_slot = i;
+			break;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+BlinePublisherT<T>::Reader::~Reader()
+{
+	if (m_slot < MAX_READERS) {
+		m_publisher.m_slots[m_slot].epoch = IDLE;
+		m_publisher.m_slots[m_slot].used = false;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+const typename BlinePublisherT<T>::Line* BlinePublisherT<T>::Reader::enter(void)
+{
+	//without a slot no line could be protected
+	if (m_slot >= MAX_READERS) return nullptr;
+
+	Slot& slot = m_publisher.m_slots[m_slot];
+	assert(slot.epoch == IDLE);
+
+	//announce first, then load. all sequentially consistent, so a writer which missed the
+	//announcement had swapped its line in before the load
+	slot.epoch = m_publisher.m_epoch.load();
+	return m_publisher.m_current.load();
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlinePublisherT<T>::Reader::leave(void)
+{
+	if (m_slot >= MAX_READERS) return;
+	m_publisher.m_slots[m_slot].epoch.store(IDLE, std::memory_order_release);
+}
+
+//--------------------------------------------------------------------------------------
+template class BlinePublisherT<float>;
+template class BlinePublisherT<double>;
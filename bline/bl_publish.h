@@ -0,0 +1,89 @@
+#pragma once
+#include "bl_line.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+
+//Publishes built lines to many reader threads while a writer keeps rebuilding.
+//The writer moves a built line in with publish(), which swaps it in atomically. Readers
+//never lock: a Reader announces the epoch it entered in, and a replaced line is only
+//deleted once every reader has left the epoch it was replaced in.
+template<typename T>
+class BlinePublisherT
+{
+public:
+	typedef BlineT<T> Line;
+
+	enum { MAX_READERS = 64 };
+
+	//one per reader thread, takes a slot of the publisher for its lifetime. a reader made
+	//while MAX_READERS others live gets no slot, its enter() always gives nullptr as before
+	//the first publish(), and it has to be made again once a slot is free
+	class Reader
+	{
+	public:
+		//the current line, valid until leave(). enter() does not nest
+		const Line* enter(void);
+		void leave(void);
+		bool hasSlot(void) const { return m_slot < MAX_READERS; }
+
+	public:
+		Reader(BlinePublisherT& publisher);
+		~Reader();
+
+	private:
+		BlinePublisherT&	m_publisher;
+		size_t				m_slot;
+
+		Reader(const Reader&) = delete;
+		Reader& operator=(const Reader&) = delete;
+	};
+
+	//swaps the line in, readers entering from now on see it. the replaced line is deleted
+	//as soon as no reader can hold it any more
+	void publish(Line&& line);
+	//deletes the replaced lines no reader holds, publish() does this too
+	void reclaim(void);
+
+	//replaced lines still waiting for readers
+	size_t getRetiredCounts(void) const;
+
+private:
+	static const uint64_t IDLE = ~(uint64_t)0;
+
+	//own cache line each, readers only write their own
+	struct alignas(64) Slot
+	{
+		std::atomic<uint64_t> epoch;
+		std::atomic<bool> used;
+	};
+
+	struct Retired
+	{
+		const Line* line;
+		uint64_t epoch;		//replaced in this epoch
+	};
+
+	std::atomic<const Line*>	m_current;
+	std::atomic<uint64_t>		m_epoch;
+	Slot						m_slots[MAX_READERS];
+
+	//writer side only
+	mutable std::mutex			m_writerLock;
+	std::vector<Retired>		m_retired;
+
+private:
+	void _reclaim(void);
+
+public:
+	BlinePublisherT();
+	~BlinePublisherT();
+
+private:
+	BlinePublisherT(const BlinePublisherT&) = delete;
+	BlinePublisherT& operator=(const BlinePublisherT&) = delete;
+};
+
+typedef BlinePublisherT<double> BlinePublisher;
+typedef BlinePublisherT<float> BlinePublisherF;
@@ -0,0 +1,204 @@
+#include "bl_set.h"
+#include <assert.h>
+#include <stdint.h>
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+BlineSetT<T>::Arena::Arena()
+	: m_used(0)
+	, m_usedBytes(0)
+{
+
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+BlineSetT<T>::Arena::~Arena()
+{
+	release();
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void* BlineSetT<T>::Arena::allocate(size_t bytes, size_t alignment)
+{
+	assert(alignment <= BLOCK_ALIGNMENT);
+
+	if (!m_blocks.empty()) {
+		Block& block = m_blocks.back();
+		uintptr_t begin = (uintptr_t)(block.data + m_used);
+		uintptr_t aligned = (begin + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		size_t used = (size_t)(aligned - (uintptr_t)block.data) + bytes;
+		if (used <= block.size) {
+			m_usedBytes += used - m_used;
+			m_used = used;
+			return (void*)aligned;
+		}
+	}
+
+	//a new block, half of all so far, so a growing build takes few of them
+	size_t size = getBytes() / 2;
+	if (size < MIN_BLOCK_SIZE) size = MIN_BLOCK_SIZE;
+	if (size < bytes) size = bytes;
+
+	Block block;
+	block.data = (char*)BlineAllocator::getDefault()->allocate(size, BLOCK_ALIGNMENT);
+	block.size = size;
+	assert(((uintptr_t)block.data & (BLOCK_ALIGNMENT - 1)) == 0);
+	m_blocks.push_back(block);
+
+	m_used = bytes;
+	m_usedBytes += bytes;
+	return block.data;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineSetT<T>::Arena::deallocate(void*, size_t, size_t)
+{
+	//all at once in reset()
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineSetT<T>::Arena::reset(void)
+{
+	//one block for what the last build used, with room for different alignment padding
+	if (m_blocks.size() > 1) {
+		size_t size = m_usedBytes + m_usedBytes / 64;
+		release();
+
+		Block block;
+		block.data = (char*)BlineAllocator::getDefault()->allocate(size, BLOCK_ALIGNMENT);
+		block.size = size;
+		m_blocks.push_back(block);
+	}
+	m_used = 0;
+	m_usedBytes = 0;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineSetT<T>::Arena::release(void)
+{
+	for (size_t i = 0; i < m_blocks.size(); i++) {
+		BlineAllocator::getDefault()->deallocate(m_blocks[i].data, m_blocks[i].size, BLOCK_ALIGNMENT);
+	}
+	m_blocks.clear();
+	m_used = 0;
+	m_usedBytes = 0;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+size_t BlineSetT<T>::Arena::getBytes(void) const
+{
+	size_t bytes = 0;
+	for (size_t i = 0; i < m_blocks.size(); i++) {
+		bytes += m_blocks[i].size;
+	}
+	return bytes;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+BlineSetT<T>::BlineSetT()
+	: m_lengthMode(Line::LM_SPATIAL)
+	, m_fastInvert(false)
+	, m_fastInvertError((Real)0.0001)
+	, m_fastInvertPolish(false)
+{
+
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+BlineSetT<T>::~BlineSetT()
+{
+	release();
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineSetT<T>::release(void)
+{
+	m_lines.clear();
+	m_keyOffsets.clear();
+	m_arena.release();
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineSetT<T>::setFastInvert(bool enable, Real maxError, bool polish)
+{
+	m_fastInvert = enable;
+	m_fastInvertError = maxError;
+	m_fastInvertPolish = polish;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+bool BlineSetT<T>::build(const Real* keyPoints, const size_t* keyCounts, size_t lineCounts)
+{
+	for (size_t i = 0; i < lineCounts; i++) {
+		if (keyCounts[i] < 3) return false;
+	}
+
+	//the old lines give nothing back, the arena forgets them all at once
+	m_lines.clear();
+	m_arena.reset();
+
+	m_lines.resize(lineCounts);
+	m_keyOffsets.resize(lineCounts);
+
+	size_t offset = 0;
+	for (size_t i = 0; i < lineCounts; i++) {
+		Line& line = m_lines[i];
+		line.setAllocator(&m_arena);
+		line.setLengthMode(m_lengthMode);
+		line.setFastInvert(m_fastInvert, m_fastInvertError, m_fastInvertPolish);
+
+		line.build(keyPoints + offset * 3, keyCounts[i]);
+		m_keyOffsets[i] = offset;
+		offset += keyCounts[i];
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineSetT<T>::getPoint(size_t line, Real t, Point& point, Point& tangent) const
+{
+	assert(line < m_lines.size());
+	m_lines[line].getPoint(t, point, tangent);
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineSetT<T>::getPoints(const size_t* lines, const Real* t, size_t counts, const PointArray& points, const PointArray& tangents) const
+{
+	size_t begin = 0;
+	while (begin < counts) {
+		size_t end = begin + 1;
+		while (end < counts && lines[end] == lines[begin]) end++;
+
+		assert(lines[begin] < m_lines.size());
+		PointArray pt = { points.x + begin, points.y + begin, points.z + begin };
+		PointArray ta = { tangents.x + begin, tangents.y + begin, tangents.z + begin };
+		m_lines[lines[begin]].getPoints(t + begin, end - begin, pt, ta);
+
+		begin = end;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template<typename T>
+void BlineSetT<T>::getArenaInfo(size_t& bytes, size_t& usedBytes) const
+{
+	bytes = m_arena.getBytes();
+	usedBytes = m_arena.getUsedBytes();
+}
+
+//--------------------------------------------------------------------------------------
+template class BlineSetT<float>;
+template class BlineSetT<double>;
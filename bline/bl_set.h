@@ -0,0 +1,96 @@
+#pragma once
+#include "bl_line.h"
+#include <vector>
+
+//Many lines built into one arena. The arrays of every line are bump allocated back to
+//back in build order, so the memory of the set is a few large blocks instead of some
+//arrays per line, and the lines themselves sit in one array. A rebuild keeps the arena,
+//merged into one block large enough for the last build.
+template<typename T>
+class BlineSetT
+{
+public:
+	typedef BlineT<T> Line;
+	typedef typename Line::Real Real;
+	typedef typename Line::Point Point;
+	typedef typename Line::PointArray PointArray;
+
+	//line i takes keyCounts[i] keys, at least 3, the keys of all lines back to back
+	bool build(const Real* keyPoints, const size_t* keyCounts, size_t lineCounts);
+	//frees the lines and the arena
+	void release(void);
+
+	size_t		getLineCounts(void) const { return m_lines.size(); }
+	const Line&	getLine(size_t index) const { return m_lines[index]; }
+	//first key of line index in the keys given to build()
+	size_t		getKeyOffset(size_t index) const { return m_keyOffsets[index]; }
+
+	void	getPoint(size_t line, Real t, Point& point, Point& tangent) const;
+	//sample i is line lines[i] at t[i]. runs on one line go through the batch path of the
+	//line, so samples sorted by line are the fastest
+	void	getPoints(const size_t* lines, const Real* t, size_t counts, const PointArray& points, const PointArray& tangents) const;
+
+	//applied to every line of the next build()
+	void	setLengthMode(typename Line::LengthMode mode) { m_lengthMode = mode; }
+	void	setFastInvert(bool enable, Real maxError = (Real)0.0001, bool polish = false);
+
+	//memory taken from the heap for the arena, and the part of it in use
+	void	getArenaInfo(size_t& bytes, size_t& usedBytes) const;
+
+private:
+	//bump allocator over a list of blocks, nothing is freed before reset()
+	class Arena : public BlineAllocator
+	{
+	public:
+		virtual void* allocate(size_t bytes, size_t alignment);
+		virtual void deallocate(void* p, size_t bytes, size_t alignment);
+
+		//forgets every allocation, more than one block are merged into one
+		void reset(void);
+		void release(void);
+
+		size_t getBytes(void) const;
+		size_t getUsedBytes(void) const { return m_usedBytes; }
+
+	public:
+		Arena();
+		~Arena();
+
+	private:
+		struct Block
+		{
+			char* data;
+			size_t size;
+		};
+
+		enum { BLOCK_ALIGNMENT = 64, MIN_BLOCK_SIZE = 64 * 1024 };
+
+		std::vector<Block>	m_blocks;
+		size_t				m_used;			//of the last block
+		size_t				m_usedBytes;	//of all blocks, alignment included
+
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+	};
+
+	//declared first, the lines give their memory back to it when destroyed
+	Arena				m_arena;
+	std::vector<Line>	m_lines;
+	std::vector<size_t>	m_keyOffsets;
+
+	typename Line::LengthMode	m_lengthMode;
+	bool		m_fastInvert;
+	Real		m_fastInvertError;
+	bool		m_fastInvertPolish;
+
+public:
+	BlineSetT();
+	~BlineSetT();
+
+private:
+	BlineSetT(const BlineSetT&) = delete;
+	BlineSetT& operator=(const BlineSetT&) = delete;
+};
+
+typedef BlineSetT<double> BlineSet;
+typedef BlineSetT<float> BlineSetF;
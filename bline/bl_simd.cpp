@@ -0,0 +1,374 @@
+#include "bl_simd.h"
+#include <math.h>
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BL_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+//msvc takes avx2 intrinsics in any function, gcc and clang need the target enabled per function
+#if defined(BL_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define BL_TARGET_SSE2 __attribute__((target("sse2")))
+#define BL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define BL_TARGET_SSE2
+#define BL_TARGET_AVX2
+#endif
+
+//same threshold as Bline::_normalize
+#define BL_NORMALIZE_EPSILON (0.0000001)
+
+//found on first use, threads sampling shared lines may race to it and store the same value
+static std::atomic<int> s_supportedLevel(-1);
+static std::atomic<int> s_level(-1);
+
+//--------------------------------------------------------------------------------------
+BlineSimd::Level BlineSimd::getSupportedLevel(void)
+{
+	int supported = s_supportedLevel;
+	if (supported >= 0) return (Level)supported;
+
+	Level level = SL_SCALAR;
+#if defined(BL_SIMD_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxId = info[0];
+
+	__cpuid(info, 1);
+	if (info[3] & (1 << 26)) level = SL_SSE2;
+
+	//avx2 needs the os to save the ymm registers too
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (maxId >= 7 && osxsave && (_xgetbv(0) & 6) == 6) {
+		__cpuidex(info, 7, 0);
+		if (info[1] & (1 << 5)) level = SL_AVX2;
+	}
+#elif defined(BL_SIMD_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2")) level = SL_SSE2;
+	if (__builtin_cpu_supports("avx2")) level = SL_AVX2;
+#endif
+
+	s_supportedLevel = level;
+	return level;
+}
+
+//--------------------------------------------------------------------------------------
+BlineSimd::Level BlineSimd::getLevel(void)
+{
+	int level = s_level;
+	if (level < 0) s_level = level = getSupportedLevel();
+	return (Level)level;
+}
+
+//--------------------------------------------------------------------------------------
+void BlineSimd::setLevel(Level level)
+{
+	Level supported = getSupportedLevel();
+	s_level = (level > supported) ? supported : level;
+}
+
+//--------------------------------------------------------------------------------------
+void BlineSimd::evaluate(const double* t, const size_t* part, size_t counts, const double* controls, size_t stride,
+	double* px, double* py, double* pz, double* tx, double* ty, double* tz)
+{
+	switch (getLevel()) {
+	case SL_AVX2:
+		_evaluateAVX2(t, part, counts, controls, stride, px, py, pz, tx, ty, tz);
+		break;
+	case SL_SSE2:
+		_evaluateSSE2(t, part, counts, controls, stride, px, py, pz, tx, ty, tz);
+		break;
+	default:
+		_evaluateScalar(t, part, counts, controls, stride, px, py, pz, tx, ty, tz);
+		break;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+void BlineSimd::evaluate(const float* t, const size_t* part, size_t counts, const float* controls, size_t stride,
+	float* px, float* py, float* pz, float* tx, float* ty, float* tz)
+{
+	switch (getLevel()) {
+	case SL_AVX2:
+		_evaluateAVX2(t, part, counts, controls, stride, px, py, pz, tx, ty, tz);
+		break;
+	case SL_SSE2:
+		_evaluateSSE2(t, part, counts, controls, stride, px, py, pz, tx, ty, tz);
+		break;
+	default:
+		_evaluateScalar(t, part, counts, controls, stride, px, py, pz, tx, ty, tz);
+		break;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template<typename Real>
+static void _evaluateScalarT(const Real* t, const size_t* part, size_t counts, const Real* controls, size_t stride,
+	Real* px, Real* py, Real* pz, Real* tx, Real* ty, Real* tz)
+{
+	for (size_t i = 0; i < counts; i++) {
+		Real p[3], d[3];
+		BlineSimd::bezier(controls + part[i] * stride, t[i], p, d);
+		px[i] = p[0]; py[i] = p[1]; pz[i] = p[2];
+
+		Real x = d[0], y = d[1], z = d[2];
+		Real length = x*x + y*y + z*z;
+		if (!(length < (Real)BL_NORMALIZE_EPSILON)) {
+			length = sqrt(length);
+			x /= length;
+			y /= length;
+			z /= length;
+		}
+		tx[i] = x; ty[i] = y; tz[i] = z;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+void BlineSimd::_evaluateScalar(const double* t, const size_t* part, size_t counts, const double* controls, size_t stride,
+	double* px, double* py, double* pz, double* tx, double* ty, double* tz)
+{
+	_evaluateScalarT(t, part, counts, controls, stride, px, py, pz, tx, ty, tz);
+}
+
+//--------------------------------------------------------------------------------------
+void BlineSimd::_evaluateScalar(const float* t, const size_t* part, size_t counts, const float* controls, size_t stride,
+	float* px, float* py, float* pz, float* tx, float* ty, float* tz)
+{
+	_evaluateScalarT(t, part, counts, controls, stride, px, py, pz, tx, ty, tz);
+}
+
+#ifdef BL_SIMD_X86
+//--------------------------------------------------------------------------------------
+BL_TARGET_SSE2 void BlineSimd::_evaluateSSE2(const double* t, const size_t* part, size_t counts, const double* controls, size_t stride,
+	double* px, double* py, double* pz, double* tx, double* ty, double* tz)
+{
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d two = _mm_set1_pd(2.0);
+	const __m128d four = _mm_set1_pd(4.0);
+	const __m128d epsilon = _mm_set1_pd(BL_NORMALIZE_EPSILON);
+
+	size_t i = 0;
+	for (; i + 2 <= counts; i += 2) {
+		const double* c0 = controls + part[i] * stride;
+		const double* c1 = controls + part[i + 1] * stride;
+
+		__m128d s = _mm_loadu_pd(t + i);
+		__m128d r = _mm_sub_pd(one, s);
+		__m128d b0 = _mm_mul_pd(r, r);
+		__m128d b1 = _mm_mul_pd(_mm_mul_pd(two, r), s);
+		__m128d b2 = _mm_mul_pd(s, s);
+		__m128d d0 = _mm_mul_pd(two, _mm_sub_pd(s, one));
+		__m128d d1 = _mm_sub_pd(two, _mm_mul_pd(four, s));
+		__m128d d2 = _mm_mul_pd(two, s);
+
+		__m128d tangent[3];
+		double* position[3] = { px + i, py + i, pz + i };
+		for (int k = 0; k < 3; k++) {
+			__m128d p0 = _mm_set_pd(c1[k], c0[k]);
+			__m128d p1 = _mm_set_pd(c1[k + 3], c0[k + 3]);
+			__m128d p2 = _mm_set_pd(c1[k + 6], c0[k + 6]);
+
+			_mm_storeu_pd(position[k], _mm_add_pd(_mm_add_pd(_mm_mul_pd(b0, p0), _mm_mul_pd(b1, p1)), _mm_mul_pd(b2, p2)));
+			tangent[k] = _mm_add_pd(_mm_add_pd(_mm_mul_pd(d0, p0), _mm_mul_pd(d1, p1)), _mm_mul_pd(d2, p2));
+		}
+
+		__m128d length = _mm_add_pd(_mm_add_pd(_mm_mul_pd(tangent[0], tangent[0]), _mm_mul_pd(tangent[1], tangent[1])),
+			_mm_mul_pd(tangent[2], tangent[2]));
+		__m128d mask = _mm_cmpnlt_pd(length, epsilon);
+		length = _mm_sqrt_pd(length);
+
+		double* result[3] = { tx + i, ty + i, tz + i };
+		for (int k = 0; k < 3; k++) {
+			__m128d n = _mm_div_pd(tangent[k], length);
+			_mm_storeu_pd(result[k], _mm_or_pd(_mm_and_pd(mask, n), _mm_andnot_pd(mask, tangent[k])));
+		}
+	}
+
+	_evaluateScalar(t + i, part + i, counts - i, controls, stride, px + i, py + i, pz + i, tx + i, ty + i, tz + i);
+}
+
+//--------------------------------------------------------------------------------------
+BL_TARGET_AVX2 void BlineSimd::_evaluateAVX2(const double* t, const size_t* part, size_t counts, const double* controls, size_t stride,
+	double* px, double* py, double* pz, double* tx, double* ty, double* tz)
+{
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d two = _mm256_set1_pd(2.0);
+	const __m256d four = _mm256_set1_pd(4.0);
+	const __m256d epsilon = _mm256_set1_pd(BL_NORMALIZE_EPSILON);
+
+	size_t i = 0;
+	for (; i + 4 <= counts; i += 4) {
+		//element offsets of the four parts, gathered once per control value
+		__m256i offset = _mm256_set_epi64x((long long)(part[i + 3] * stride), (long long)(part[i + 2] * stride),
+			(long long)(part[i + 1] * stride), (long long)(part[i] * stride));
+
+		__m256d s = _mm256_loadu_pd(t + i);
+		__m256d r = _mm256_sub_pd(one, s);
+		__m256d b0 = _mm256_mul_pd(r, r);
+		__m256d b1 = _mm256_mul_pd(_mm256_mul_pd(two, r), s);
+		__m256d b2 = _mm256_mul_pd(s, s);
+		__m256d d0 = _mm256_mul_pd(two, _mm256_sub_pd(s, one));
+		__m256d d1 = _mm256_sub_pd(two, _mm256_mul_pd(four, s));
+		__m256d d2 = _mm256_mul_pd(two, s);
+
+		__m256d tangent[3];
+		double* position[3] = { px + i, py + i, pz + i };
+		for (int k = 0; k < 3; k++) {
+			__m256d p0 = _mm256_i64gather_pd(controls + k, offset, 8);
+			__m256d p1 = _mm256_i64gather_pd(controls + k + 3, offset, 8);
+			__m256d p2 = _mm256_i64gather_pd(controls + k + 6, offset, 8);
+
+			_mm256_storeu_pd(position[k], _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(b0, p0), _mm256_mul_pd(b1, p1)), _mm256_mul_pd(b2, p2)));
+			tangent[k] = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(d0, p0), _mm256_mul_pd(d1, p1)), _mm256_mul_pd(d2, p2));
+		}
+
+		__m256d length = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(tangent[0], tangent[0]), _mm256_mul_pd(tangent[1], tangent[1])),
+			_mm256_mul_pd(tangent[2], tangent[2]));
+		__m256d mask = _mm256_cmp_pd(length, epsilon, _CMP_NLT_UQ);
+		length = _mm256_sqrt_pd(length);
+
+		double* result[3] = { tx + i, ty + i, tz + i };
+		for (int k = 0; k < 3; k++) {
+			_mm256_storeu_pd(result[k], _mm256_blendv_pd(tangent[k], _mm256_div_pd(tangent[k], length), mask));
+		}
+	}
+
+	_evaluateScalar(t + i, part + i, counts - i, controls, stride, px + i, py + i, pz + i, tx + i, ty + i, tz + i);
+}
+
+//--------------------------------------------------------------------------------------
+BL_TARGET_SSE2 void BlineSimd::_evaluateSSE2(const float* t, const size_t* part, size_t counts, const float* controls, size_t stride,
+	float* px, float* py, float* pz, float* tx, float* ty, float* tz)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 four = _mm_set1_ps(4.0f);
+	const __m128 epsilon = _mm_set1_ps((float)BL_NORMALIZE_EPSILON);
+
+	size_t i = 0;
+	for (; i + 4 <= counts; i += 4) {
+		const float* c[4];
+		for (int j = 0; j < 4; j++) c[j] = controls + part[i + j] * stride;
+
+		__m128 s = _mm_loadu_ps(t + i);
+		__m128 r = _mm_sub_ps(one, s);
+		__m128 b0 = _mm_mul_ps(r, r);
+		__m128 b1 = _mm_mul_ps(_mm_mul_ps(two, r), s);
+		__m128 b2 = _mm_mul_ps(s, s);
+		__m128 d0 = _mm_mul_ps(two, _mm_sub_ps(s, one));
+		__m128 d1 = _mm_sub_ps(two, _mm_mul_ps(four, s));
+		__m128 d2 = _mm_mul_ps(two, s);
+
+		__m128 tangent[3];
+		float* position[3] = { px + i, py + i, pz + i };
+		for (int k = 0; k < 3; k++) {
+			__m128 p0 = _mm_set_ps(c[3][k], c[2][k], c[1][k], c[0][k]);
+			__m128 p1 = _mm_set_ps(c[3][k + 3], c[2][k + 3], c[1][k + 3], c[0][k + 3]);
+			__m128 p2 = _mm_set_ps(c[3][k + 6], c[2][k + 6], c[1][k + 6], c[0][k + 6]);
+
+			_mm_storeu_ps(position[k], _mm_add_ps(_mm_add_ps(_mm_mul_ps(b0, p0), _mm_mul_ps(b1, p1)), _mm_mul_ps(b2, p2)));
+			tangent[k] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d0, p0), _mm_mul_ps(d1, p1)), _mm_mul_ps(d2, p2));
+		}
+
+		__m128 length = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tangent[0], tangent[0]), _mm_mul_ps(tangent[1], tangent[1])),
+			_mm_mul_ps(tangent[2], tangent[2]));
+		__m128 mask = _mm_cmpnlt_ps(length, epsilon);
+		length = _mm_sqrt_ps(length);
+
+		float* result[3] = { tx + i, ty + i, tz + i };
+		for (int k = 0; k < 3; k++) {
+			__m128 n = _mm_div_ps(tangent[k], length);
+			_mm_storeu_ps(result[k], _mm_or_ps(_mm_and_ps(mask, n), _mm_andnot_ps(mask, tangent[k])));
+		}
+	}
+
+	_evaluateScalar(t + i, part + i, counts - i, controls, stride, px + i, py + i, pz + i, tx + i, ty + i, tz + i);
+}
+
+//--------------------------------------------------------------------------------------
+BL_TARGET_AVX2 void BlineSimd::_evaluateAVX2(const float* t, const size_t* part, size_t counts, const float* controls, size_t stride,
+	float* px, float* py, float* pz, float* tx, float* ty, float* tz)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 four = _mm256_set1_ps(4.0f);
+	const __m256 epsilon = _mm256_set1_ps((float)BL_NORMALIZE_EPSILON);
+
+	size_t i = 0;
+	for (; i + 8 <= counts; i += 8) {
+		//64 bit element offsets, two gathers of four floats per control value
+		__m256i offsetLow = _mm256_set_epi64x((long long)(part[i + 3] * stride), (long long)(part[i + 2] * stride),
+			(long long)(part[i + 1] * stride), (long long)(part[i] * stride));
+		__m256i offsetHigh = _mm256_set_epi64x((long long)(part[i + 7] * stride), (long long)(part[i + 6] * stride),
+			(long long)(part[i + 5] * stride), (long long)(part[i + 4] * stride));
+
+		__m256 s = _mm256_loadu_ps(t + i);
+		__m256 r = _mm256_sub_ps(one, s);
+		__m256 b0 = _mm256_mul_ps(r, r);
+		__m256 b1 = _mm256_mul_ps(_mm256_mul_ps(two, r), s);
+		__m256 b2 = _mm256_mul_ps(s, s);
+		__m256 d0 = _mm256_mul_ps(two, _mm256_sub_ps(s, one));
+		__m256 d1 = _mm256_sub_ps(two, _mm256_mul_ps(four, s));
+		__m256 d2 = _mm256_mul_ps(two, s);
+
+		__m256 tangent[3];
+		float* position[3] = { px + i, py + i, pz + i };
+		for (int k = 0; k < 3; k++) {
+			__m256 p[3];
+			for (int j = 0; j < 3; j++) {
+				const float* base = controls + k + j * 3;
+				p[j] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_i64gather_ps(base, offsetLow, 4)),
+					_mm256_i64gather_ps(base, offsetHigh, 4), 1);
+			}
+
+			_mm256_storeu_ps(position[k], _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(b0, p[0]), _mm256_mul_ps(b1, p[1])), _mm256_mul_ps(b2, p[2])));
+			tangent[k] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(d0, p[0]), _mm256_mul_ps(d1, p[1])), _mm256_mul_ps(d2, p[2]));
+		}
+
+		__m256 length = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tangent[0], tangent[0]), _mm256_mul_ps(tangent[1], tangent[1])),
+			_mm256_mul_ps(tangent[2], tangent[2]));
+		__m256 mask = _mm256_cmp_ps(length, epsilon, _CMP_NLT_UQ);
+		length = _mm256_sqrt_ps(length);
+
+		float* result[3] = { tx + i, ty + i, tz + i };
+		for (int k = 0; k < 3; k++) {
+			_mm256_storeu_ps(result[k], _mm256_blendv_ps(tangent[k], _mm256_div_ps(tangent[k], length), mask));
+		}
+	}
+
+	_evaluateScalar(t + i, part + i, counts - i, controls, stride, px + i, py + i, pz + i, tx + i, ty + i, tz + i);
+}
+#else
+//--------------------------------------------------------------------------------------
+void BlineSimd::_evaluateSSE2(const double* t, const size_t* part, size_t counts, const double* controls, size_t stride,
+	double* px, double* py, double* pz, double* tx, double* ty, double* tz)
+{
+	_evaluateScalar(t, part, counts, controls, stride, px, py, pz, tx, ty, tz);
+}
+
+//--------------------------------------------------------------------------------------
+void BlineSimd::_evaluateAVX2(const double* t, const size_t* part, size_t counts, const double* controls, size_t stride,
+	double* px, double* py, double* pz, double* tx, double* ty, double* tz)
+{
+	_evaluateScalar(t, part, counts, controls, stride, px, py, pz, tx, ty, tz);
+}
+
+//--------------------------------------------------------------------------------------
+void BlineSimd::_evaluateSSE2(const float* t, const size_t* part, size_t counts, const float* controls, size_t stride,
+	float* px, float* py, float* pz, float* tx, float* ty, float* tz)
+{
+	_evaluateScalar(t, part, counts, controls, stride, px, py, pz, tx, ty, tz);
+}
+
+//--------------------------------------------------------------------------------------
+void BlineSimd::_evaluateAVX2(const float* t, const size_t* part, size_t counts, const float* controls, size_t stride,
+	float* px, float* py, float* pz, float* tx, float* ty, float* tz)
+{
+	_evaluateScalar(t, part, counts, controls, stride, px, py, pz, tx, ty, tz);
+}
+#endif
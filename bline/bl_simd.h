@@ -0,0 +1,56 @@
+#pragma once
+#include <stddef.h>
+
+//Quadratic bezier kernels, position and normalized tangent of many samples at once.
+//Sample i evaluates part[i] at t[i], the 9 control values of a part (pt0, pt1, pt2 as xyz)
+//are consecutive at controls + part[i]*stride. Results are structure of arrays.
+class BlineSimd
+{
+public:
+	enum Level
+	{
+		SL_SCALAR,
+		SL_SSE2,	//2 doubles or 4 floats
+		SL_AVX2,	//4 doubles or 8 floats
+	};
+
+	//best level this cpu supports, detected once
+	static Level getSupportedLevel(void);
+	//level used by evaluate(), can be lowered to compare kernels
+	static Level getLevel(void);
+	static void setLevel(Level level);
+
+	static void evaluate(const double* t, const size_t* part, size_t counts, const double* controls, size_t stride,
+		double* px, double* py, double* pz, double* tx, double* ty, double* tz);
+	static void evaluate(const float* t, const size_t* part, size_t counts, const float* controls, size_t stride,
+		float* px, float* py, float* pz, float* tx, float* ty, float* tz);
+
+	//one part at s, the tangent not normalized. every scalar evaluation of a line goes
+	//through here and the vector kernels use the same expressions, so all give the same bits
+	template<typename Real>
+	static void bezier(const Real* c, Real s, Real* point, Real* tangent)
+	{
+		point[0] = (1 - s)*(1 - s)*c[0] + 2 * (1 - s)*s*c[3] + s*s*c[6];
+		point[1] = (1 - s)*(1 - s)*c[1] + 2 * (1 - s)*s*c[4] + s*s*c[7];
+		point[2] = (1 - s)*(1 - s)*c[2] + 2 * (1 - s)*s*c[5] + s*s*c[8];
+
+		tangent[0] = 2 * (s - 1)*c[0] + (2 - 4 * s)*c[3] + 2 * s*c[6];
+		tangent[1] = 2 * (s - 1)*c[1] + (2 - 4 * s)*c[4] + 2 * s*c[7];
+		tangent[2] = 2 * (s - 1)*c[2] + (2 - 4 * s)*c[5] + 2 * s*c[8];
+	}
+
+private:
+	static void _evaluateScalar(const double* t, const size_t* part, size_t counts, const double* controls, size_t stride,
+		double* px, double* py, double* pz, double* tx, double* ty, double* tz);
+	static void _evaluateSSE2(const double* t, const size_t* part, size_t counts, const double* controls, size_t stride,
+		double* px, double* py, double* pz, double* tx, double* ty, double* tz);
+	static void _evaluateAVX2(const double* t, const size_t* part, size_t counts, const double* controls, size_t stride,
+		double* px, double* py, double* pz, double* tx, double* ty, double* tz);
+
+	static void _evaluateScalar(const float* t, const size_t* part, size_t counts, const float* controls, size_t stride,
+		float* px, float* py, float* pz, float* tx, float* ty, float* tz);
+	static void _evaluateSSE2(const float* t, const size_t* part, size_t counts, const float* controls, size_t stride,
+		float* px, float* py, float* pz, float* tx, float* ty, float* tz);
+	static void _evaluateAVX2(const float* t, const size_t* part, size_t counts, const float* controls, size_t stride,
+		float* px, float* py, float* pz, float* tx, float* ty, float* tz);
+};